@@ -0,0 +1,68 @@
+/* Copyright (c) 2025 Paul Winwood, G8KIG - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the GPL-Version 3 license.
+ *
+ * There is a copy of the GPL-Version 3 license in the same folder as this file.
+ */
+
+#pragma once
+
+#ifndef BAND_STATS_HOURS
+#define BAND_STATS_HOURS 24 // rolling hourly buckets kept
+#endif
+
+static const uint8_t SNR_BINS = 8;          // below -20, 5 dB steps, then 10 and over
+static const uint8_t DISTINCT_REGISTERS = 32; // HyperLogLog registers, about 18% error
+static const int8_t snrBinFloor[SNR_BINS] = {-128, -20, -15, -10, -5, 0, 5, 10};
+
+// One band in one hour, or every band when asked for BAND_UNKNOWN
+struct BandHourStats
+{
+    uint32_t hour;   // hours since the epoch
+    uint32_t spots;
+    uint32_t unique; // estimated distinct callsigns
+    uint32_t snr[SNR_BINS];
+};
+
+// Spots per band per hour, distinct callsigns and SNR distributions, in a
+// fixed block. A spot costs a table lookup for the band, a few counter
+// increments and a mix of the callsign's key. The distinct counts are
+// HyperLogLog sketches, so hours and bands can be merged when queried.
+class BandStats
+{
+public:
+    BandStats();
+
+    // callsign is the packed callsign, or the hash of the text of one that
+    // does not pack, so a station counts once however it was sent
+    void add(uint32_t callsign, uint32_t frequency, int8_t snr, uint32_t now);
+
+    // hoursAgo 0 is the current hour; false if nothing was recorded then
+    bool hourStats(uint8_t hoursAgo, uint8_t band, BandHourStats &stats) const;
+
+    // Distinct callsigns over the last hours, on one band or all
+    uint32_t uniqueCallsigns(uint8_t hours, uint8_t band) const;
+    uint32_t unbandedSpots() const { return unbanded; } // outside every band
+
+    BandStats &operator=(const BandStats &other) = delete;
+
+private:
+    static const uint32_t NO_HOUR = 0xFFFFFFFF;
+
+    struct HourBucket
+    {
+        uint32_t hour;
+        uint16_t spots[BAND_COUNT];
+        uint16_t snr[BAND_COUNT][SNR_BINS];
+        uint8_t registers[BAND_COUNT][DISTINCT_REGISTERS / 2]; // 4 bit registers
+    };
+
+    HourBucket buckets[BAND_STATS_HOURS];
+    uint32_t currentHour;
+    uint32_t unbanded;
+
+    void advance(uint32_t hour);
+    const HourBucket *bucketFor(uint8_t hoursAgo) const;
+    static void mergeRegisters(const uint8_t *registers, uint8_t *merged);
+    static uint32_t estimate(const uint8_t *registers);
+};
@@ -0,0 +1,89 @@
+/* Copyright (c) 2025 Paul Winwood, G8KIG - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the GPL-Version 3 license.
+ *
+ * There is a copy of the GPL-Version 3 license in the same folder as this file.
+ */
+
+#pragma once
+
+struct Band
+{
+    const char *name;
+    uint32_t lowHz;
+    uint32_t highHz;
+    uint32_t ft8Hz; // usual FT8 dial frequency
+};
+
+static constexpr Band bands[] = {
+    {"160m", 1800000, 2000000, 1840000},
+    {"80m", 3500000, 4000000, 3573000},
+    {"60m", 5250000, 5450000, 5357000},
+    {"40m", 7000000, 7300000, 7074000},
+    {"30m", 10100000, 10150000, 10136000},
+    {"20m", 14000000, 14350000, 14074000},
+    {"17m", 18068000, 18168000, 18100000},
+    {"15m", 21000000, 21450000, 21074000},
+    {"12m", 24890000, 24990000, 24915000},
+    {"10m", 28000000, 29700000, 28074000},
+    {"6m", 50000000, 54000000, 50313000},
+    {"4m", 70000000, 70500000, 70154000},
+    {"2m", 144000000, 148000000, 144174000}};
+
+static constexpr uint8_t BAND_COUNT = sizeof(bands) / sizeof(bands[0]);
+static constexpr uint8_t BAND_UNKNOWN = 0xFF;
+
+// Index into bands[] of the band holding the frequency, or BAND_UNKNOWN
+constexpr uint8_t bandIndex(uint32_t frequency, uint8_t idx = 0)
+{
+    return idx >= BAND_COUNT                                                  ? BAND_UNKNOWN
+           : (frequency >= bands[idx].lowHz && frequency <= bands[idx].highHz) ? idx
+                                                                               : bandIndex(frequency, idx + 1);
+}
+
+// Index of the band covering any part of the whole MHz, or BAND_UNKNOWN. No
+// two bands share a MHz.
+constexpr uint8_t megahertzBand(uint32_t mhz, uint8_t idx = 0)
+{
+    return idx >= BAND_COUNT                                                                    ? BAND_UNKNOWN
+           : (mhz >= bands[idx].lowHz / 1000000 && mhz <= bands[idx].highHz / 1000000) ? idx
+                                                                                        : megahertzBand(mhz, idx + 1);
+}
+
+// megahertzBand() of every MHz up to the top of the highest band, built by
+// the compiler
+template <uint32_t... Mhz>
+struct MegahertzBandTable
+{
+    static constexpr uint8_t table[sizeof...(Mhz)] = {megahertzBand(Mhz)...};
+};
+
+template <uint32_t... Mhz>
+constexpr uint8_t MegahertzBandTable<Mhz...>::table[sizeof...(Mhz)];
+
+template <uint32_t N, uint32_t... Mhz>
+struct MakeMegahertzBandTable : MakeMegahertzBandTable<N - 1, N - 1, Mhz...>
+{
+};
+
+template <uint32_t... Mhz>
+struct MakeMegahertzBandTable<0, Mhz...>
+{
+    typedef MegahertzBandTable<Mhz...> type;
+};
+
+static constexpr uint32_t BAND_TABLE_MHZ = bands[BAND_COUNT - 1].highHz / 1000000 + 1;
+typedef MakeMegahertzBandTable<BAND_TABLE_MHZ>::type BandTable;
+static_assert(BandTable::table[14] == bandIndex(14074000), "band table");
+
+// Same answer as bandIndex() with one table read and one range check, for
+// the per spot paths
+inline uint8_t lookupBand(uint32_t frequency)
+{
+    uint32_t mhz = frequency / 1000000;
+    uint8_t band = mhz < BAND_TABLE_MHZ ? BandTable::table[mhz] : BAND_UNKNOWN;
+    return band != BAND_UNKNOWN && frequency >= bands[band].lowHz && frequency <= bands[band].highHz ? band : BAND_UNKNOWN;
+}
+
+// Index of the band with the given name, such as "20m", or BAND_UNKNOWN
+uint8_t bandFromName(const char *name);
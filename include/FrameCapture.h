@@ -0,0 +1,67 @@
+/* Copyright (c) 2025 Paul Winwood, G8KIG - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the GPL-Version 3 license.
+ *
+ * There is a copy of the GPL-Version 3 license in the same folder as this file.
+ */
+
+#pragma once
+
+// Records opcode frames exactly as the transport delivers them, so a real
+// session can be replayed later. The frame handler copies each frame into
+// a ring in RAM and the main loop writes the ring to a LittleFS file, which
+// starts again once it is full, keeping the one before as path.old.
+//
+// The file is "FCAP" then, for each frame, the microseconds since the frame
+// before it (32 bits, least significant byte first), the frame's length in
+// one byte and the frame itself, opcode byte first.
+static const uint8_t CAPTURE_MAGIC[4] = {'F', 'C', 'A', 'P'};
+static const size_t CAPTURE_HEADER_SIZE = 5; // before each frame
+
+#ifndef CAPTURE_RING_SIZE
+#define CAPTURE_RING_SIZE 4096 // bytes waiting for the main loop
+#endif
+#ifndef CAPTURE_PATH
+#define CAPTURE_PATH "/capture.bin" // until beginCapture() is given another
+#endif
+#ifndef CAPTURE_FILE_SIZE
+#define CAPTURE_FILE_SIZE (256 * 1024) // bytes before the file starts again
+#endif
+
+struct CaptureStats
+{
+    uint32_t frames;  // frames written
+    uint32_t bytes;   // bytes written, headers included
+    uint32_t dropped; // frames lost because the ring was full
+    uint32_t files;   // times the file started again
+};
+
+bool beginCapture(const char *path); // starts a new file
+void endCapture();                   // writes what is left and closes it
+bool captureActive();
+const char *capturePath();    // the file being written, or the last one
+const char *captureOldPath(); // the file before it
+
+void captureFrame(const uint8_t *frame, size_t length); // from the frame handler
+void flushCapture();                                    // from the main loop
+void holdCaptureRollover(bool hold); // the file runs past its size while held
+
+const CaptureStats &captureStats();
+void printCaptureStats();
+
+// Reads a capture back a frame at a time
+class CaptureReader
+{
+public:
+    CaptureReader();
+    ~CaptureReader();
+
+    bool open(const char *path); // false when missing or not a capture
+    bool next(uint32_t &deltaMicros, uint8_t *frame, size_t &length); // frame holds 255 bytes
+    void close();
+
+    CaptureReader &operator=(const CaptureReader &other) = delete;
+
+private:
+    File file;
+};
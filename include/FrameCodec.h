@@ -0,0 +1,54 @@
+/* Copyright (c) 2025 Paul Winwood, G8KIG - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the GPL-Version 3 license.
+ *
+ * There is a copy of the GPL-Version 3 license in the same folder as this file.
+ */
+
+#pragma once
+
+// Framing for byte stream transports. A frame is its length, the frame
+// itself and a CRC-32 of both, COBS encoded so it holds no zero bytes and
+// followed by a zero as the delimiter. A receiver that starts part way
+// through, or loses bytes, is back in step at the next zero.
+
+static const size_t MAX_FRAME_SIZE = 32;        // opcode and payload, as much as one I2C write
+static const size_t FRAME_HEADER_SIZE = 1;      // length
+static const size_t FRAME_TRAILER_SIZE = 4;     // CRC-32, little endian
+static const size_t MAX_ENCODED_FRAME_SIZE =
+    FRAME_HEADER_SIZE + MAX_FRAME_SIZE + FRAME_TRAILER_SIZE + 1 + 1; // COBS overhead and delimiter
+
+enum FrameStatus
+{
+    FRAME_PENDING = 0, // nothing complete yet
+    FRAME_READY,
+    FRAME_CORRUPT, // bad encoding or length
+    FRAME_BAD_CRC,
+    FRAME_OVERRUN // no delimiter where there should have been one
+};
+
+// Returns the bytes written including the delimiter, 0 if it does not fit
+size_t encodeFrame(const uint8_t *frame, size_t length, uint8_t *out, size_t outSize);
+
+class FrameAssembler
+{
+public:
+    FrameAssembler();
+
+    // Takes the next received byte. After FRAME_READY the frame stays valid
+    // until the next call.
+    FrameStatus push(uint8_t byte);
+    void reset();
+
+    const uint8_t *frame() const { return decoded + FRAME_HEADER_SIZE; }
+    size_t frameLength() const { return length; }
+
+private:
+    uint8_t encoded[MAX_ENCODED_FRAME_SIZE];
+    uint8_t decoded[MAX_ENCODED_FRAME_SIZE];
+    size_t fill;
+    size_t length;
+    bool discarding; // after an overrun, until the next delimiter
+
+    FrameStatus complete();
+};
@@ -0,0 +1,72 @@
+/* Copyright (c) 2025 Paul Winwood, G8KIG - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the GPL-Version 3 license.
+ *
+ * There is a copy of the GPL-Version 3 license in the same folder as this file.
+ */
+
+#pragma once
+
+static const uint8_t MAX_CALLSIGN_LENGTH = 16;
+static const uint8_t MAX_SOFTWARE_LENGTH = 30;
+
+// Non-owning view of a length-prefixed string inside a frame buffer.
+// Only valid while the buffer it points into is.
+struct StringView
+{
+    const char *data;
+    uint8_t length;
+
+    bool equals(const char *other, size_t otherLength) const;
+};
+
+// Fixed capacity copy of a string received in a frame, longer strings are
+// truncated
+template <size_t N>
+struct InlineString
+{
+    char data[N + 1];
+    uint8_t length;
+
+    InlineString() : length(0)
+    {
+        data[0] = 0;
+    }
+
+    void assign(const StringView &view)
+    {
+        length = view.length < N ? view.length : N;
+        memcpy(data, view.data, length);
+        data[length] = 0;
+    }
+};
+
+struct SenderRecordView
+{
+    StringView callsign;
+    StringView gridSquare;
+};
+
+struct SenderSoftwareRecordView
+{
+    StringView software;
+};
+
+struct ReceivedRecordView
+{
+    StringView callsign; // empty when a standard callsign came packed
+    uint32_t packed;     // callsign as FT8 sent it, 0 when it came as text
+    uint32_t frequency;
+    uint8_t snr;
+};
+
+// Each decoder checks the whole payload against its real length in a single
+// pass and returns false, leaving the view unusable, if any field would run
+// past the end or a callsign is empty, too long or not printable.
+bool decodeSenderRecord(const uint8_t *buffer, size_t length, SenderRecordView &record);
+bool decodeSenderSoftwareRecord(const uint8_t *buffer, size_t length, SenderSoftwareRecordView &record);
+bool decodeReceivedRecord(const uint8_t *buffer, size_t length, ReceivedRecordView &record);
+
+// A packed spot carries the callsign as FT8 sent it, frequency and SNR.
+// A hash, which only the transceiver can resolve, is followed by the text.
+bool decodePackedReceivedRecord(const uint8_t *buffer, size_t length, ReceivedRecordView &record);
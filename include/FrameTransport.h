@@ -0,0 +1,80 @@
+/* Copyright (c) 2025 Paul Winwood, G8KIG - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the GPL-Version 3 license.
+ *
+ * There is a copy of the GPL-Version 3 license in the same folder as this file.
+ */
+
+#pragma once
+
+// Called with each frame received, the opcode byte then its payload.
+// Returns true when the sender expects a reply.
+typedef bool (*FrameHandler)(const uint8_t *frame, size_t length, void *context);
+
+// Fills in the reply, the same bytes whichever transport asks, and returns
+// its length
+typedef size_t (*ReplySource)(uint8_t *reply, size_t size, void *context);
+
+// Called from the driver's task when bytes are waiting for poll(), so the
+// main loop can sleep until then
+typedef void (*TransportWakeup)();
+
+struct TransportStats
+{
+    uint32_t frames;        // good frames delivered
+    uint32_t bytes;         // bytes received, framing included
+    uint32_t replies;       // replies sent
+    uint32_t corrupt;       // frames with a bad encoding or length
+    uint32_t crcErrors;     // frames failing the CRC
+    uint32_t overruns;      // frames too long, or missing a delimiter
+    uint32_t maxPollMicros; // longest poll(), the time the loop is held
+};
+
+// How frames reach the opcode handlers, which neither know nor care
+class FrameTransport
+{
+public:
+    FrameTransport();
+    virtual ~FrameTransport();
+
+    void setHandlers(FrameHandler frameHandler, ReplySource replySource, void *context);
+    void setWakeup(TransportWakeup wakeup) { wakeupHandler = wakeup; } // before begin()
+
+    virtual bool begin() = 0;
+    virtual void poll() = 0; // delivers whatever has arrived
+    virtual const char *name() const = 0;
+
+    const TransportStats &stats() const { return transportStats; }
+    void printStats() const;
+
+    FrameTransport &operator=(const FrameTransport &other) = delete;
+
+protected:
+    TransportStats transportStats;
+    TransportWakeup wakeupHandler;
+
+    bool deliverFrame(const uint8_t *frame, size_t length);
+    size_t fetchReply(uint8_t *reply, size_t size);
+
+private:
+    FrameHandler frameHandler;
+    ReplySource replySource;
+    void *context;
+};
+
+// Base for transports that carry frames over a byte stream, encoded as in
+// FrameCodec.h. A reply is sent back down the same stream as a frame.
+class StreamTransport : public FrameTransport
+{
+public:
+    StreamTransport();
+
+protected:
+    void receiveBytes(const uint8_t *data, size_t length);
+    virtual bool writeBytes(const uint8_t *data, size_t length) = 0;
+
+private:
+    FrameAssembler assembler;
+
+    void sendReply();
+};
@@ -0,0 +1,30 @@
+/* Copyright (c) 2025 Paul Winwood, G8KIG - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the GPL-Version 3 license.
+ *
+ * There is a copy of the GPL-Version 3 license in the same folder as this file.
+ */
+
+#pragma once
+
+// Frames from the I2C master's writes, one frame per write. The master
+// reads the reply with a separate request, so nothing is pushed back.
+// Built with I2C_FRAME_CRC, every write and every reply ends with a CRC-32
+// of the rest, and a write that fails it is counted and dropped before it
+// reaches the work queue.
+class I2CTransport final : public FrameTransport
+{
+public:
+    explicit I2CTransport(uint8_t address);
+
+    bool begin() override;
+    void poll() override;
+    const char *name() const override { return "I2C"; }
+
+private:
+    uint8_t address;
+
+    static I2CTransport *instance;
+    static void receiveEvent(int length);
+    static void requestEvent();
+};
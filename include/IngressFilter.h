@@ -0,0 +1,71 @@
+/* Copyright (c) 2025 Paul Winwood, G8KIG - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the GPL-Version 3 license.
+ *
+ * There is a copy of the GPL-Version 3 license in the same folder as this file.
+ */
+
+#pragma once
+
+#ifndef INGRESS_FILTER_DEPTH
+#define INGRESS_FILTER_DEPTH 10 // spots waiting before repeats are dropped on arrival, 0 always
+#endif
+
+// Smallest power of two of at least 16 bits a record, which with three
+// probes keeps false positives to about 0.5% at most with the store full
+constexpr size_t ingressFilterBits(size_t records, size_t bits = 32)
+{
+    return bits >= 16 * records ? bits : ingressFilterBits(records, bits * 2);
+}
+
+struct IngressFilterStats
+{
+    uint32_t checked;        // spots looked up as they arrived
+    uint32_t matched;        // of which the station was known
+    uint32_t dropped;        // of which were dropped, the queue slots saved
+    uint32_t newStations;    // spots that started a record
+    uint32_t falsePositives; // of which the filter had already matched
+};
+
+// Approximate set of the stations waiting in each receiver's record store,
+// so a repeat decode can be recognised as it arrives, before it takes a
+// queue slot. A Bloom filter with three probes: a station that was added is
+// always found, one that was not is found now and again. Only the thread
+// that owns the reporters writes it, adding stations as records are
+// accepted and clearing a receiver when it sends. The receive path only
+// reads whole words, so it needs no lock.
+class IngressFilter
+{
+public:
+    IngressFilter();
+
+    // Keys are RecordStore::stationKey(), on both paths.
+    // From the receive path. True when the spot should be dropped: the
+    // station is known and dropping was asked for.
+    bool checkArrival(uint8_t receiver, uint32_t key, bool dropRepeats);
+
+    // From the reporter's thread
+    void addStation(uint8_t receiver, uint32_t key);
+    void clear(uint8_t receiver);
+
+    void getStats(IngressFilterStats &stats) const;
+    void resetStats();
+    double fillRatio() const; // share of the bits set, over every receiver
+    void printStats() const;
+
+    IngressFilter &operator=(const IngressFilter &other) = delete;
+
+private:
+    static constexpr size_t FILTER_BITS = ingressFilterBits(PSK_MAX_RECORDS);
+    static constexpr size_t FILTER_WORDS = FILTER_BITS / 32;
+    static const int PROBES = 3;
+
+    volatile uint32_t bits[MAX_RECEIVERS][FILTER_WORDS];
+    volatile uint32_t checked;
+    volatile uint32_t matched;
+    volatile uint32_t dropped;
+    uint32_t newStations;
+    uint32_t falsePositives;
+
+    bool contains(uint8_t receiver, uint32_t key) const;
+};
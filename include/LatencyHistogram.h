@@ -0,0 +1,36 @@
+/* Copyright (c) 2025 Paul Winwood, G8KIG - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the GPL-Version 3 license.
+ *
+ * There is a copy of the GPL-Version 3 license in the same folder as this file.
+ */
+
+#pragma once
+
+// Fixed size latency histogram in microseconds.
+// Buckets are powers of two split into four linear sub-buckets, so any
+// percentile is reported to within 25% without storing individual samples.
+class LatencyHistogram
+{
+public:
+    LatencyHistogram();
+
+    void reset();
+    void record(uint32_t microseconds);
+
+    uint32_t count() const;
+    uint32_t maximum() const;
+
+    // Upper bound of the bucket holding the given percentile (0 - 100)
+    uint32_t percentile(uint32_t percent) const;
+
+private:
+    static const int BUCKET_COUNT = 96;
+
+    uint32_t buckets[BUCKET_COUNT];
+    uint32_t samples;
+    uint32_t maxValue;
+
+    static int bucketIndex(uint32_t value);
+    static uint32_t bucketUpperBound(int index);
+};
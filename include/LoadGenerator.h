@@ -0,0 +1,51 @@
+/* Copyright (c) 2025 Paul Winwood, G8KIG - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the GPL-Version 3 license.
+ *
+ * There is a copy of the GPL-Version 3 license in the same folder as this file.
+ */
+
+#pragma once
+
+// Synthetic transceiver traffic. Each FT8 slot delivers a burst of decodes
+// through handleReceivedFrame(), exactly as receiveEvent() would, and the
+// work queue statistics are collected while the main loop drains them.
+struct LoadGeneratorConfig
+{
+    uint16_t burstSize = 80;           // decodes delivered per slot
+    uint16_t burstWindowMs = 500;      // time taken to deliver one burst
+    uint16_t slotPeriodMs = 15000;     // FT8 slot length, 0 starts each burst once the last has drained
+    uint16_t slots = 20;               // slots to replay, 20 is one flush period
+    uint16_t stationCount = 400;       // distinct stations on the band
+    uint8_t repeatPercent = 60;        // decodes of a station heard recently
+    uint32_t baseFrequency = 14074000; // dial frequency in Hz
+    uint32_t seed = 0x2A2A2A2A;        // same seed, same traffic
+    bool flushAtEnd = true;            // finish with an OP_SEND_REQUEST
+};
+
+struct LoadGeneratorReport
+{
+    uint32_t framesOffered;
+    uint32_t elapsedMs;  // wall clock time of the whole run
+    uint32_t busyMicros; // time from each burst start until the queue drained
+    WorkQueueStats queue;
+};
+
+void runLoadGenerator(const LoadGeneratorConfig &config, LoadGeneratorReport &report);
+void printLoadGeneratorReport(const LoadGeneratorConfig &config, const LoadGeneratorReport &report);
+
+// Transceiver side encoders, payload only (no operation byte)
+size_t encodeSenderRecord(uint8_t *buffer, size_t bufferSize, const char *callsign, const char *gridSquare);
+size_t encodeSenderSoftwareRecord(uint8_t *buffer, size_t bufferSize, const char *software);
+size_t encodeReceivedRecord(uint8_t *buffer, size_t bufferSize, const char *callsign, uint32_t frequency, uint8_t snr);
+// The callsign packed as FT8 sends it, with its text only when it does not pack
+size_t encodePackedReceivedRecord(uint8_t *buffer, size_t bufferSize, const char *callsign, uint32_t frequency, uint8_t snr);
+
+// Synthetic stations, shared with the soak test
+uint32_t nextRandom(uint32_t &state);                 // xorshift32, never returns 0 for a non-zero state
+void stationCallsign(uint32_t station, char *callsign); // at least 12 bytes
+uint32_t stationHash(uint32_t station);               // stable per station, for offsets and levels
+
+// Times SafeString's Format and builder against the two pass Format it
+// replaced, for spot log lines and a JSON document of spots
+void benchmarkStringBuilding(uint32_t rounds);
@@ -0,0 +1,46 @@
+/* Copyright (c) 2025 Paul Winwood, G8KIG - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the GPL-Version 3 license.
+ *
+ * There is a copy of the GPL-Version 3 license in the same folder as this file.
+ */
+
+#pragma once
+
+#ifndef NTP_SERVER
+#define NTP_SERVER "pool.ntp.org"
+#endif
+#ifndef NTP_INTERVAL_MS
+#define NTP_INTERVAL_MS 120000 // between successful time updates
+#endif
+
+// Called from the network task with the time from the NTP server
+typedef void (*NetworkTimeHandler)(uint32_t epochSeconds, uint16_t milliseconds);
+
+struct NetworkStats
+{
+    uint32_t connects;       // times the link came up
+    uint32_t disconnects;    // times it was lost
+    uint32_t fastReconnects; // connects to the cached access point
+    uint32_t portals;        // times the configuration portal was started
+    uint32_t ntpRequests;
+    uint32_t ntpReplies;     // replies that set the time
+    uint32_t ntpTimeouts;
+    uint32_t ntpRejected;    // replies that did not match or were unsynchronised
+    uint32_t ntpRoundTripMs; // of the last reply
+    unsigned long connectedAfterBootMs; // first connect, 0 until then
+    unsigned long lastTimeUpdateMs;     // millis() at the last update, 0 for never
+};
+
+// The WiFi link, the configuration portal and NTP run as one state machine
+// in the network task, which also sends the reports. Each step only looks
+// at what has changed and returns how long the task may sleep, so nothing
+// waits on the network apart from a DNS lookup.
+void beginNetworkService(NetworkTimeHandler timeHandler);
+uint32_t serviceNetwork(); // milliseconds until the next step is due
+
+// Scans in the background and prints what was found
+void requestNetworkScan();
+
+const NetworkStats &networkStats();
+void printNetworkStats();
@@ -7,49 +7,54 @@
 
 #pragma once
 
-struct ReceivedRecord
+struct ReporterStats
 {
-    SafeString callsign;
-    uint32_t frequency;
-    uint8_t snr;
-    SafeString mode;
-    uint8_t infoSource;
-    uint32_t flowTimeSeconds;
-
-    ReceivedRecord();
-    ReceivedRecord(const SafeString &callsign,
-                   uint32_t frequency,
-                   uint8_t snr);
-
-    ReceivedRecord &operator=(const ReceivedRecord &other) = delete;
-
-    size_t encode(uint8_t *buf) const;
+    uint32_t accepted;    // spots that started or updated a record
+    uint32_t storeFull;   // spots of a new station dropped, every record in use
+    uint32_t textTableFull; // spots of a callsign that does not pack dropped, no room for its text
 };
 
-class PskReporter
+class PskReporter final
 {
 public:
-    PskReporter(uint32_t randomIdentifier, bool testMode = false);
-    virtual ~PskReporter();
-
-    bool createSenderRecord(const uint8_t *encodedBuf);
-    bool createSenderSoftwareRecord(const uint8_t *encodedBuf);
-    bool addReceivedRecord(const uint8_t *encodedBuf);
+    explicit PskReporter(uint32_t randomIdentifier = 0);
+    ~PskReporter();
+
+    bool createSenderRecord(const uint8_t *encodedBuf, size_t length);
+    bool createSenderSoftwareRecord(const uint8_t *encodedBuf, size_t length);
+    bool addReceivedRecord(const uint8_t *encodedBuf, size_t length);
+    bool addPackedReceivedRecord(const uint8_t *encodedBuf, size_t length);
+    bool addReceivedRecord(const ReceivedRecordView &record);
     bool send();
 
+    size_t pendingRecords() const { return records.size(); }
+    const ReporterStats &stats() const { return reporterStats; }
+
+    void setRandomIdentifier(uint32_t identifier);
+    void setReportStatistic(ReportStatistic statistic);
+    void setSpotHistory(SpotHistory *history);
+    void setBandStats(BandStats *stats);
+    void setIngressFilter(IngressFilter *filter, uint8_t receiver);
+
     PskReporter &operator=(const PskReporter &other) = delete;
 
 private:
     uint32_t currentSequenceNumber;
     uint32_t randomIdentifier;
-    bool testMode;
-
-    SafeString reporterCallsign;
-    SafeString reporterGridSquare;
-    SafeString decodingSoftware;
-    std::vector<ReceivedRecord> recordList;
+    ReportStatistic reportStatistic;
+
+    InlineString<MAX_CALLSIGN_LENGTH> reporterCallsign;
+    InlineString<MAX_CALLSIGN_LENGTH> reporterGridSquare;
+    InlineString<MAX_SOFTWARE_LENGTH> decodingSoftware;
+    RecordStore records;
+    ReporterStats reporterStats;
+    SpotHistory *spotHistory;
+    BandStats *bandStats;
+    IngressFilter *ingressFilter;
+    uint8_t filterReceiver;
 
     size_t encodeReporterRecord(uint8_t *buf) const;
-    size_t encodeReceivedRecords(uint8_t *buf);
-    bool alreadyLogged(const SafeString &callsign) const;
+    size_t encodeDatagram(uint8_t *buf, const ReceivedRecord *&next);
+    size_t encodeReceivedRecords(uint8_t *buf, size_t space, const ReceivedRecord *&next);
+    void recordHistory() const;
 };
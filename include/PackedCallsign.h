@@ -0,0 +1,45 @@
+/* Copyright (c) 2025 Paul Winwood, G8KIG - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the GPL-Version 3 license.
+ *
+ * There is a copy of the GPL-Version 3 license in the same folder as this file.
+ */
+
+#pragma once
+
+// FT8 sends a callsign as a 28 bit number, c28. The lowest values are
+// tokens such as CQ, then come 22 bit hashes of callsigns too long to pack,
+// which only the transceiver that heard the full callsign can resolve, and
+// the rest are standard callsigns of up to six characters. The /R or /P
+// FT8 carries in a bit of its own goes in bits 28 and 29.
+static const uint32_t C28_TOKENS = 2063592;
+static const uint32_t C28_HASHES = 4194304;
+static const uint32_t C28_STANDARD = C28_TOKENS + C28_HASHES;
+static const uint32_t C28_MASK = 0x0FFFFFFF;
+static const uint8_t CALLSIGN_SUFFIX_SHIFT = 28;
+
+enum CallsignSuffix
+{
+    SUFFIX_NONE = 0,
+    SUFFIX_R,
+    SUFFIX_P
+};
+
+inline bool isStandardCallsign(uint32_t packed)
+{
+    return (packed & C28_MASK) >= C28_STANDARD && (packed >> CALLSIGN_SUFFIX_SHIFT) <= SUFFIX_P;
+}
+
+// A callsign a spot can carry: a standard one or a hash, not a token
+inline bool isValidPackedCallsign(uint32_t packed)
+{
+    return (packed & C28_MASK) >= C28_TOKENS && (packed >> CALLSIGN_SUFFIX_SHIFT) <= SUFFIX_P;
+}
+
+// Packs an upper case callsign, with an optional /R or /P, as FT8 would;
+// false when it is not a standard callsign
+bool packCallsign(const char *text, size_t length, uint32_t &packed);
+
+// Writes a standard callsign to text, which needs 10 bytes, and returns its
+// length, or 0 when the value is not a standard callsign
+size_t unpackCallsign(uint32_t packed, char *text);
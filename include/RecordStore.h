@@ -0,0 +1,120 @@
+/* Copyright (c) 2025 Paul Winwood, G8KIG - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the GPL-Version 3 license.
+ *
+ * There is a copy of the GPL-Version 3 license in the same folder as this file.
+ */
+
+#pragma once
+
+#ifndef PSK_MAX_RECORDS
+#define PSK_MAX_RECORDS 40 // must be less than the max datagram size
+#endif
+
+#ifndef NONSTANDARD_CALLSIGNS
+#define NONSTANDARD_CALLSIGNS PSK_MAX_RECORDS // callsigns that do not pack kept as text per window
+#endif
+
+class RecordStore;
+
+// Which decode of a station is reported when the window is flushed
+enum ReportStatistic
+{
+    REPORT_BEST_SNR = 0, // strongest SNR, most recent frequency
+    REPORT_LATEST,       // most recent decode
+    REPORT_FIRST         // first decode in the window
+};
+
+// Everything heard from one callsign during a reporting window. The
+// callsign is its packed FT8 value, or for one that does not pack the key
+// of its text in the store, and is only turned into text when encoded.
+struct ReceivedRecord
+{
+    uint32_t callsign;
+    uint32_t firstFrequency;
+    uint32_t latestFrequency;
+    uint32_t firstSeen;
+    uint32_t lastSeen;
+    uint16_t decodes;
+    int8_t firstSnr;
+    int8_t bestSnr;
+    int8_t latestSnr;
+    uint8_t infoSource;
+
+    void initialise(uint32_t callsign, const ReceivedRecordView &record, uint32_t now);
+    void update(const ReceivedRecordView &record, uint32_t now);
+
+    // The values reported for the chosen statistic
+    void select(ReportStatistic statistic, uint32_t &frequency, int8_t &snr, uint32_t &time) const;
+
+    size_t encode(uint8_t *buf, ReportStatistic statistic, const RecordStore &store) const;
+};
+
+// Smallest power of two at least twice the number of records
+constexpr size_t recordIndexSize(size_t records, size_t size = 1)
+{
+    return size >= 2 * records ? size : recordIndexSize(records, size * 2);
+}
+
+// Fixed capacity record store with an open addressing hash index on the
+// packed callsign, so a decode is found and updated in place in O(1) with
+// an integer compare. Records are kept in arrival order for encoding.
+class RecordStore
+{
+public:
+    RecordStore();
+
+    // The key a decode is stored under: its packed callsign, whether it came
+    // packed or as text that packs, or else a key for its text, which is
+    // kept until clear(). False when there is no room for the text.
+    bool callsignKey(const ReceivedRecordView &record, uint32_t &key);
+
+    // Returns the record for the key, or reserves a new one for the caller
+    // to initialise if it has not been seen; NULL when full
+    ReceivedRecord *findOrInsert(uint32_t callsign, bool &inserted);
+    const ReceivedRecord *find(uint32_t callsign) const;
+
+    // Writes the callsign to text, MAX_CALLSIGN_LENGTH + 1 bytes, and
+    // returns its length
+    size_t callsignText(uint32_t callsign, char *text) const;
+
+    void clear();
+    size_t size() const;
+    bool empty() const;
+    size_t capacity() const;
+
+    const ReceivedRecord *begin() const;
+    const ReceivedRecord *end() const;
+
+    static uint32_t hash(const StringView &callsign); // FNV-1a
+
+    // The key BandStats and the ingress filter know a station by, with no
+    // store needed: its packed callsign, from the frame or its text, or
+    // else the hash of its text
+    static uint32_t stationKey(const ReceivedRecordView &record);
+
+private:
+    struct NonstandardCallsign
+    {
+        uint32_t hash;
+        char text[MAX_CALLSIGN_LENGTH];
+        uint8_t length;
+    };
+
+    static constexpr size_t INDEX_SIZE = recordIndexSize(PSK_MAX_RECORDS);
+    static constexpr size_t NONSTANDARD_INDEX_SIZE = recordIndexSize(NONSTANDARD_CALLSIGNS);
+    static const int16_t EMPTY_SLOT = -1;
+    static_assert(PSK_MAX_RECORDS < 32768, "record index is 16 bits");
+    static_assert(NONSTANDARD_CALLSIGNS < 32768, "callsign text index is 16 bits");
+
+    ReceivedRecord records[PSK_MAX_RECORDS];
+    int16_t index[INDEX_SIZE];
+    size_t count;
+    NonstandardCallsign nonstandard[NONSTANDARD_CALLSIGNS];
+    int16_t nonstandardIndex[NONSTANDARD_INDEX_SIZE];
+    size_t nonstandardCount;
+
+    static bool packedKey(const ReceivedRecordView &record, uint32_t &key);
+    size_t probe(uint32_t callsign) const;
+    size_t probeText(const StringView &callsign, uint32_t hash) const;
+};
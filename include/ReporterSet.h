@@ -0,0 +1,36 @@
+/* Copyright (c) 2025 Paul Winwood, G8KIG - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the GPL-Version 3 license.
+ *
+ * There is a copy of the GPL-Version 3 license in the same folder as this file.
+ */
+
+#pragma once
+
+// One reporter per receiver behind the bridge, each with its own callsign,
+// locator, record store and sequence number, so spots from different
+// receivers are never merged with each other
+class ReporterSet
+{
+public:
+    ReporterSet();
+
+    // Receiver 0 keeps the base identifier, so a single receiver setup
+    // reports exactly as before. The filter, which may be NULL, is shared
+    // with the work queue.
+    void begin(uint32_t baseIdentifier, ReportStatistic statistic, SpotHistory *history, BandStats *stats,
+               IngressFilter *filter);
+
+    PskReporter *get(uint8_t receiver); // NULL for an unknown receiver
+
+    // Flushes every receiver with spots waiting and wakes the sinks once
+    // for the lot
+    bool sendAll();
+    size_t pendingRecords() const;
+    void printStats() const; // spots accepted and dropped, over every receiver
+
+    ReporterSet &operator=(const ReporterSet &other) = delete;
+
+private:
+    PskReporter reporters[MAX_RECEIVERS];
+};
@@ -17,8 +17,9 @@ public:
     SafeString(size_t len);
     SafeString(const SafeString &other);
 
-    // Destructor
-    virtual ~SafeString();
+    // Destructor - not virtual, nothing derives from it and a vtable
+    // pointer would be carried by every string
+    ~SafeString();
 
     // Assignment operator
     SafeString &operator=(const SafeString &other);
@@ -41,20 +42,36 @@ public:
     // Get the current reference count
     int getRefCount() const;
 
-    // Format the string using printf-style formatting
+    // Get the number of characters that fit without reallocating
+    size_t capacity() const;
+
+    // Format the string using printf-style formatting, false and an empty
+    // string when the result cannot be stored
     bool Format(const char *fmt, ...);
 
+    // Builder - the buffer grows geometrically, so a string built up by
+    // appends is reallocated a handful of times rather than on every call,
+    // and clear() keeps the buffer for the next line. Like append(), the
+    // formatting calls may be given a pointer into the string itself.
+    bool reserve(size_t capacity);
+    bool append(const char *s);
+    bool append(const char *s, size_t len);
+    bool appendFormat(const char *fmt, ...);
+    void clear();
+
 private:
     // This struct holds the actual string data and the reference count
     struct StringData
     {
         char *data;
         size_t length;
+        size_t capacity; // characters, not counting the terminator
         int refCount;
 
         StringData();
         StringData(const char *s, size_t len);
-        virtual ~StringData();
+        StringData(const char *s, size_t len, size_t capacity);
+        ~StringData();
 
         StringData &operator=(const StringData &other) = delete;
     };
@@ -64,4 +81,7 @@ private:
     static char EmptyChar;
 
     void detach(); // Helper for copy-on-write
+    bool reallocate(size_t capacity);
+    bool grow(size_t required);
+    bool formatAt(size_t offset, const char *fmt, va_list args);
 };
@@ -0,0 +1,47 @@
+/* Copyright (c) 2025 Paul Winwood, G8KIG - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the GPL-Version 3 license.
+ *
+ * There is a copy of the GPL-Version 3 license in the same folder as this file.
+ */
+
+#pragma once
+
+// Weeks of synthetic traffic through a PskReporter and spot history of its
+// own, as fast as they will run, with the heap sampled through the heap caps
+// statistics. On the board these are the real heap; the Linux daemon backs
+// them with a fixed size first fit arena. The run fails if the heap in use,
+// or the largest free block, is worse at the end than once the stores first
+// filled.
+struct SoakConfig
+{
+    uint16_t days = 14;              // simulated days, at least 3
+    uint16_t flushSeconds = 300;     // report interval
+    uint16_t peakDecodes = 60;       // decodes in a busy FT8 slot
+    uint16_t stationCount = 5000;    // distinct stations heard over the run
+    uint16_t historyCapacity = 2000; // spots in the run's own history
+    uint16_t sampleMinutes = 60;     // simulated minutes between heap samples
+    uint32_t driftTolerance = 512;   // bytes the footprint may move by
+    uint32_t seed = 0x50A4C0DE;      // same seed, same traffic
+};
+
+struct SoakReport
+{
+    uint32_t spots;
+    uint32_t flushes;
+    uint32_t samples;
+    uint32_t elapsedMs;
+    size_t startUsed;           // heap in use before the run allocated anything
+    size_t endUsed;             // and after it freed everything again
+    size_t peakUsed;
+    size_t baselineUsed;        // highest use on the second day
+    size_t finalUsed;           // highest use on the last day
+    size_t baselineLargest;     // smallest largest free block on the second day
+    size_t finalLargest;        // smallest largest free block on the last day
+    uint8_t worstFragmentation; // percent of the free heap outside the largest block
+    bool passed;
+};
+
+// Published datagrams are discarded while the test runs
+bool runSoakTest(const SoakConfig &config, SoakReport &report);
+void printSoakReport(const SoakConfig &config, const SoakReport &report);
@@ -0,0 +1,115 @@
+/* Copyright (c) 2025 Paul Winwood, G8KIG - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the GPL-Version 3 license.
+ *
+ * There is a copy of the GPL-Version 3 license in the same folder as this file.
+ */
+
+#pragma once
+
+// One spot as returned by a query
+struct HistorySpot
+{
+    StringView callsign; // points into the history, valid until the next add()
+    uint32_t time;       // start of the FT8 slot it was heard in
+    uint32_t frequency;
+    int8_t snr;
+    uint8_t band;
+};
+
+struct HistoryCounts
+{
+    uint32_t spots;
+    uint32_t uniqueCallsigns;
+    uint32_t bandSpots[BAND_COUNT];
+};
+
+typedef void (*HistoryVisitor)(const HistorySpot &spot, void *context);
+
+// Bounded rolling history of uploaded spots, oldest overwritten first.
+// Stored column-wise, 8 bytes a spot:
+//   callsign id   uint16  index into an interned callsign table
+//   band          uint8   index into bands[]
+//   frequency     int16   Hz from the band's FT8 dial frequency
+//   snr           int8
+//   time          uint16  FT8 slots (15 s) after the base time
+// plus 22 bytes per interned callsign, one for every four spots.
+// Queries scan the columns newest first and never allocate.
+class SpotHistory
+{
+public:
+    SpotHistory();
+    ~SpotHistory();
+
+    // Allocates the columns, in PSRAM when the board has it
+    bool begin(size_t capacity);
+
+    // false if the spot could not be stored
+    bool add(const StringView &callsign, uint32_t frequency, int8_t snr, uint32_t time);
+
+    size_t size() const;
+    size_t capacity() const;
+    size_t memoryUsed() const;
+    uint32_t droppedSpots() const; // spots that could not be stored
+    bool inPsram() const;
+
+    // Each callsign heard on the band (BAND_UNKNOWN for all bands) since the
+    // given time, once, with its most recent spot. Returns the number visited.
+    size_t heard(uint8_t band, uint32_t since, HistoryVisitor visitor, void *context);
+
+    // Most recent spot of a callsign and how often it was spotted
+    bool lastSeen(const StringView &callsign, HistorySpot &spot, uint32_t &spotCount) const;
+
+    // Spot and unique callsign counts since the given time
+    void counts(uint32_t since, HistoryCounts &result);
+
+    SpotHistory &operator=(const SpotHistory &other) = delete;
+
+private:
+    static const uint16_t NO_ENTRY = 0xFFFF;
+    static const uint32_t SLOT_SECONDS = 15;
+
+    // The history can hold more than 65535 spots, all of one callsign
+    struct Callsign
+    {
+        uint32_t references; // spots using this entry, free when zero
+        uint16_t next;       // hash chain or free list
+        uint8_t length;
+        char text[MAX_CALLSIGN_LENGTH];
+    };
+
+    // columns
+    uint16_t *callsignIds;
+    uint8_t *bandIndexes;
+    int16_t *frequencyOffsets;
+    int8_t *snrs;
+    uint16_t *slots;
+
+    // interned callsigns
+    Callsign *callsigns;
+    uint16_t *buckets;
+    uint32_t *seen; // one bit per interned callsign, for queries
+    uint16_t freeCallsign;
+    uint16_t callsignCapacity;
+    uint16_t bucketCount;
+
+    size_t spotCapacity;
+    size_t head; // next spot to write
+    size_t count;
+    uint32_t baseTime;
+    uint32_t dropped;
+    bool psram;
+
+    void *allocate(size_t size);
+    void release();
+    uint16_t findCallsign(const StringView &callsign) const;
+    uint16_t internCallsign(const StringView &callsign);
+    void releaseCallsign(uint16_t id);
+    void dropOldest();
+    uint16_t bucketOf(const StringView &callsign) const;
+    void rebase(uint32_t time);
+    size_t spotIndex(size_t age) const;
+    void readSpot(size_t index, HistorySpot &spot) const;
+    void clearSeen();
+    bool testAndSetSeen(uint16_t id);
+};
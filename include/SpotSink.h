@@ -0,0 +1,144 @@
+/* Copyright (c) 2025 Paul Winwood, G8KIG - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the GPL-Version 3 license.
+ *
+ * There is a copy of the GPL-Version 3 license in the same folder as this file.
+ */
+
+#pragma once
+
+#ifndef DATAGRAM_POOL_SIZE
+#define DATAGRAM_POOL_SIZE 4 // encoded datagrams that can be in flight
+#endif
+#ifndef DATAGRAM_WAIT_MS
+#define DATAGRAM_WAIT_MS 500 // a flush waits this long for the sinks to free a buffer
+#endif
+
+static const size_t MAX_DATAGRAM_SIZE = 1471; // must be less than the max datagram size
+static const int MAX_SINKS = 4;
+static_assert(DATAGRAM_POOL_SIZE < 32768, "pool index is 16 bits");
+
+// Each flush is encoded once into a pooled buffer which is then shared,
+// read only, by every sink. A buffer returns to the pool when the last
+// sink has sent it or given up on it.
+struct DatagramHandle
+{
+    int16_t index;
+    uint8_t *data;
+};
+
+enum SinkResult
+{
+    SINK_SENT = 0,
+    SINK_FAILED,   // counts against the retry limit
+    SINK_NOT_READY // no network, try again later without using a retry
+};
+
+struct SinkStats
+{
+    uint32_t queued;  // datagrams handed to the sink
+    uint32_t sent;    // datagrams delivered
+    uint32_t bytes;   // bytes delivered
+    uint32_t retries; // failed attempts that were retried
+    uint32_t failed;  // datagrams abandoned after the last retry
+    uint32_t evicted; // datagrams dropped because the pool was exhausted
+    uint32_t copied;  // bytes copied on the way to the network stack
+    uint32_t sendMicros; // time spent transmitting
+    int depth;        // datagrams waiting
+};
+
+class SpotSink
+{
+public:
+    SpotSink(const char *name, uint8_t maxAttempts, uint32_t retryIntervalMs);
+    virtual ~SpotSink();
+
+    const char *name() const { return sinkName; }
+    const SinkStats &stats() const { return sinkStats; }
+
+    // Used by the sink manager with its lock held, apart from service()
+    // which takes the lock itself and transmits without it
+    bool enqueue(int16_t index, size_t length);
+    void evict(int16_t index);
+    bool inFlight(int16_t index) const { return sending && count > 0 && queue[head].index == index; }
+    bool service(uint32_t nowMs); // true when more is ready to send
+
+    SpotSink &operator=(const SpotSink &other) = delete;
+
+protected:
+    virtual SinkResult transmit(const uint8_t *data, size_t length) = 0;
+    void countCopied(size_t bytes) { sinkStats.copied += bytes; } // from transmit()
+
+private:
+    struct QueuedDatagram
+    {
+        int16_t index;
+        uint16_t length;
+        uint8_t attempts;
+    };
+
+    const char *sinkName;
+    uint8_t maxAttempts;
+    uint32_t retryIntervalMs;
+    uint32_t nextAttemptMs;
+    QueuedDatagram queue[DATAGRAM_POOL_SIZE];
+    int head;
+    int count;
+    bool sending;
+    SinkStats sinkStats;
+};
+
+// Sends to a host name, resolved now and again, or to a fixed address
+// which may be a multicast group. The pooled buffer goes straight to
+// sendto() on a socket kept open between sends, unless UDP_SINK_BUFFERED
+// selects WiFiUDP, which copies it into a buffer of its own first.
+class UdpSink final : public SpotSink
+{
+public:
+    UdpSink(const char *name, const char *host, IPAddress address, uint16_t port,
+            uint8_t maxAttempts = 3, uint32_t retryIntervalMs = 2000);
+    ~UdpSink();
+
+protected:
+    SinkResult transmit(const uint8_t *data, size_t length) override;
+
+private:
+    const char *host;
+    IPAddress fallbackAddress;
+    IPAddress address;
+    uint32_t resolvedMs;
+    uint16_t port;
+#ifdef UDP_SINK_BUFFERED
+    WiFiUDP udp;
+#else
+    int socketFd;
+#endif
+};
+
+void initialiseSinks();
+bool addSink(SpotSink *sink);
+
+// Called from the flushing task
+bool acquireDatagram(DatagramHandle &handle);
+void publishDatagram(DatagramHandle &handle, size_t length);
+void releaseDatagram(DatagramHandle &handle); // abandon without publishing
+
+// Datagrams published between these are queued straight away but the sink
+// task is only woken at the end, so a flush of several reporters goes out
+// back to back. Buffers published in the batch are never reclaimed for it:
+// when every buffer holds part of it, the sinks are woken and it waits up
+// to DATAGRAM_WAIT_MS for one to be sent.
+void beginDatagramBatch();
+void endDatagramBatch();
+
+// While muted, published datagrams go straight back to the pool, so the
+// soak test can flush synthetic spots without them leaving the bridge
+void muteSinks(bool muted);
+
+// Called from the sink task, waits up to timeoutMs for new work
+void waitForSinkWork(uint32_t timeoutMs);
+bool serviceSinks(); // true when a sink has more ready to send
+bool sinksIdle();    // nothing waiting on any sink
+
+size_t getSinkFootprint(); // bytes of static storage
+void printSinkStats();
@@ -0,0 +1,20 @@
+/* Copyright (c) 2025 Paul Winwood, G8KIG - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the GPL-Version 3 license.
+ *
+ * There is a copy of the GPL-Version 3 license in the same folder as this file.
+ */
+
+#pragma once
+
+// Small HTTP server for querying the bridge from the LAN, served from the
+// main loop. All responses are JSON:
+//   /heard?band=20m&minutes=60  each callsign heard, with its latest spot
+//   /lastseen?call=G8KIG        latest spot of one callsign
+//   /counts?minutes=60          spots per band and unique callsigns
+//   /bands?hours=24&band=20m    hourly spots, distinct callsigns and SNR
+//                               distribution per band
+// apart from /capture, which downloads the frame capture file, running or
+// not, and /capture?old=1, the file before it
+void beginStatusServer(SpotHistory *history, BandStats *stats);
+void handleStatusServer();
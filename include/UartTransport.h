@@ -0,0 +1,43 @@
+/* Copyright (c) 2025 Paul Winwood, G8KIG - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the GPL-Version 3 license.
+ *
+ * There is a copy of the GPL-Version 3 license in the same folder as this file.
+ */
+
+#pragma once
+
+#ifndef UART_BAUD
+#define UART_BAUD 2000000
+#endif
+#ifndef UART_RX_PIN
+#define UART_RX_PIN -1 // the board's default pins for the port
+#endif
+#ifndef UART_TX_PIN
+#define UART_TX_PIN -1
+#endif
+#ifndef UART_RX_BUFFER_SIZE
+#define UART_RX_BUFFER_SIZE 4096
+#endif
+
+// Frames over a hardware UART at up to a few Mbaud. The UART driver
+// empties the receive FIFO into a ring buffer from its interrupt, and
+// poll() takes everything waiting in one read per chunk.
+class UartTransport final : public StreamTransport
+{
+public:
+    UartTransport(HardwareSerial &port, uint32_t baud, int8_t rxPin, int8_t txPin);
+
+    bool begin() override;
+    void poll() override;
+    const char *name() const override { return "UART"; }
+
+protected:
+    bool writeBytes(const uint8_t *data, size_t length) override;
+
+private:
+    HardwareSerial &port;
+    uint32_t baud;
+    int8_t rxPin;
+    int8_t txPin;
+};
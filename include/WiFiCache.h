@@ -0,0 +1,40 @@
+/* Copyright (c) 2025 Paul Winwood, G8KIG - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the GPL-Version 3 license.
+ *
+ * There is a copy of the GPL-Version 3 license in the same folder as this file.
+ */
+
+#pragma once
+
+// Details of the last successful connection, kept in NVS so the next boot
+// can join the same access point without scanning or waiting for DHCP
+struct CachedConnection
+{
+    uint8_t bssid[6];
+    int32_t channel;
+    uint32_t localIP;
+    uint32_t gateway;
+    uint32_t subnet;
+    uint32_t dns;
+};
+
+// Starts joining the cached access point with the stored credentials and
+// returns without waiting; false if there is nothing cached. The caller
+// watches WiFi.status() and calls abandonFastReconnect() if it gives up.
+bool beginFastReconnect();
+
+// Leaves the station disconnected and back on DHCP
+void abandonFastReconnect();
+
+// Hands the cached address back once the fast join is up and starts the
+// DHCP client, so the lease is renewed and a changed one is picked up.
+// The station stays joined but has no address until DHCP answers.
+void resumeDhcp();
+
+// Saves the current connection if it differs from the cached one
+void saveCachedConnection();
+
+// Forgets the cached connection, when the fast join to it failed or the
+// portal is about to be given a network
+void clearCachedConnection();
@@ -0,0 +1,19 @@
+/* Copyright (c) 2025 Paul Winwood, G8KIG - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the GPL-Version 3 license.
+ *
+ * There is a copy of the GPL-Version 3 license in the same folder as this file.
+ */
+
+#pragma once
+
+typedef void (*WsjtxWakeup)();
+
+// Listens for WSJT-X/JTDX UDP messages from PCs on the LAN. A task of its
+// own waits on the socket and calls the wakeup when datagrams arrive; they
+// are read and parsed from the main loop, so spots reach the reporter on
+// the same thread as I2C spots.
+void beginWsjtxListener(WsjtxSpotHandler handler, void *context, WsjtxWakeup wakeup);
+void watchWsjtxListener();  // from the listener's task, returns after a wait
+void handleWsjtxListener(); // from the main loop, after the wakeup
+void printWsjtxStats();
@@ -0,0 +1,65 @@
+/* Copyright (c) 2025 Paul Winwood, G8KIG - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the GPL-Version 3 license.
+ *
+ * There is a copy of the GPL-Version 3 license in the same folder as this file.
+ */
+
+#pragma once
+
+static const uint16_t WSJTX_DEFAULT_PORT = 2237;
+
+// Called for each spot decoded from a WSJT-X/JTDX datagram, the view is
+// only valid during the call. Returns true if the spot was accepted.
+typedef bool (*WsjtxSpotHandler)(const ReceivedRecordView &record, void *context);
+
+struct WsjtxStats
+{
+    uint32_t datagrams;
+    uint32_t malformed;  // bad magic, truncated or unknown schema
+    uint32_t decodes;    // Decode messages received
+    uint32_t skipped;    // not new, off air, low confidence, not FT8 or no callsign
+    uint32_t noStatus;   // decodes from a client we have no dial frequency for
+    uint32_t accepted;   // spots taken by the handler
+    uint32_t clients;    // clients seen
+};
+
+// Parser for the WSJT-X UDP message protocol. Status messages give each
+// client's dial frequency and mode, Decode messages are turned into spots
+// of the transmitting station at dial frequency plus audio offset.
+// Independent of the socket the datagrams arrive on.
+class WsjtxParser
+{
+public:
+    WsjtxParser(WsjtxSpotHandler handler, void *context);
+
+    void handleDatagram(const uint8_t *data, size_t length, uint32_t now);
+
+    const WsjtxStats &stats() const;
+
+    WsjtxParser &operator=(const WsjtxParser &other) = delete;
+
+private:
+    static const int MAX_CLIENTS = 8;
+    static const uint8_t MAX_CLIENT_ID_LENGTH = 32;
+
+    struct Client
+    {
+        InlineString<MAX_CLIENT_ID_LENGTH> id;
+        uint64_t dialFrequency;
+        bool ft8;
+        uint32_t lastHeard;
+    };
+
+    WsjtxSpotHandler handler;
+    void *context;
+    Client clients[MAX_CLIENTS];
+    int clientCount;
+    WsjtxStats statistics;
+
+    Client *findClient(const StringView &id, uint32_t now, bool create);
+};
+
+// Extracts the transmitting station from a decoded FT8 message text such as
+// "CQ DX K1ABC FN42" or "G8KIG K1ABC -12"
+bool wsjtxMessageCaller(const char *message, size_t length, StringView &callsign);
@@ -0,0 +1,21 @@
+/* Copyright (c) 2025 Paul Winwood, G8KIG - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the GPL-Version 3 license.
+ *
+ * There is a copy of the GPL-Version 3 license in the same folder as this file.
+ */
+
+#pragma once
+
+static const size_t CRC32_TRAILER_SIZE = 4; // little endian
+
+// CRC-32 as used by Ethernet and zlib. The ESP32 boards use the table in
+// ROM; elsewhere it is computed four bytes at a time from tables in flash.
+uint32_t crc32(const uint8_t *message, size_t messageSize);
+
+// Writes the CRC of the message after it, returning the length with the
+// trailer. The buffer must have room for CRC32_TRAILER_SIZE more bytes.
+size_t appendCrc32(uint8_t *message, size_t messageSize);
+
+// True when the last CRC32_TRAILER_SIZE bytes are the CRC of the rest
+bool checkCrc32(const uint8_t *message, size_t sizeWithTrailer);
@@ -18,9 +18,12 @@ struct RTCTime
     uint8_t year;
 };
 
+void handleReceivedFrame(const uint8_t *frame, size_t length);
+
 void processTimeRequest(const RTCTime *rtcTime);
-void processSenderRecord(const uint8_t *buffer);
-void processSenderSoftwareRecord(const uint8_t *buffer);
-void processReceiverRecord(const uint8_t *buffer);
-void processSendRequest();
+void processSenderRecord(uint8_t receiver, const uint8_t *buffer, size_t length);
+void processSenderSoftwareRecord(uint8_t receiver, const uint8_t *buffer, size_t length);
+void processReceiverRecord(uint8_t receiver, const uint8_t *buffer, size_t length);
+void processPackedReceiverRecord(uint8_t receiver, const uint8_t *buffer, size_t length);
+void processSendRequest(); // flushes every receiver
 
@@ -13,24 +13,86 @@ enum I2COperation
     OP_SENDER_RECORD,
     OP_SENDER_SOFTWARE_RECORD,
     OP_RECEIVER_RECORD,
-    OP_SEND_REQUEST
+    OP_SEND_REQUEST,
+    OP_PACKED_RECEIVER_RECORD // spot with the callsign as FT8 packed it
 };
 
 static const int BUFFER_SIZE = 32;
 
-enum WorkItemState
+// The high nibble of a frame's opcode byte selects the receiver, so a
+// transceiver that leaves it at 0 reports as receiver 0
+#ifndef MAX_RECEIVERS
+#define MAX_RECEIVERS 4
+#endif
+static_assert(MAX_RECEIVERS >= 1 && MAX_RECEIVERS <= 16, "the receiver is 4 bits");
+
+inline I2COperation frameOperation(uint8_t opcode)
+{
+    return (I2COperation)(opcode & 0x0F);
+}
+
+inline uint8_t frameReceiver(uint8_t opcode)
+{
+    return opcode >> 4;
+}
+
+// Control and time operations are served ahead of bulk spots. Each control
+// operation has a single slot, one per receiver for the sender records,
+// that is overwritten by a newer request, so a burst of spots can never
+// crowd them out.
+enum WorkQueueLane
 {
-    ITEM_FREE,
-    ITEM_ALLOCATED
+    LANE_CONTROL = 0,
+    LANE_BULK,
+    LANE_COUNT
 };
 
 struct WorkItem
 {
-    WorkItemState state;
     I2COperation operation;
+    uint8_t receiver;
+    uint32_t sequence; // arrival order across both lanes
+    uint32_t queuedMicros;
+    uint8_t length; // bytes of buffer actually received
     uint8_t buffer[BUFFER_SIZE];
 };
 
+struct WorkLaneStats
+{
+    uint32_t queued;    // items accepted into the lane
+    uint32_t coalesced; // items that replaced one already waiting
+    uint32_t processed; // items dispatched to a handler
+    uint32_t dropped;   // items rejected because every slot was in use
+    int depth;          // items currently waiting
+    int highWater;      // maximum depth since the last reset
+    int capacity;
+    LatencyHistogram latency; // queued to processed, in microseconds
+};
+
+struct WorkQueueStats
+{
+    WorkLaneStats lanes[LANE_COUNT];
+};
+
+// Called, outside the lock, each time an item is queued, so the consumer
+// can sleep until there is work
+typedef void (*WorkQueueSignal)();
+
+class IngressFilter;
+
 void initialiseWorkQueue();
-void addWorkQueueItem(I2COperation operation, const uint8_t *buffer, int bufferSize);
-void processWorkQueue();
+void setWorkQueueSignal(WorkQueueSignal signal);
+void setIngressFilter(IngressFilter *filter); // repeat spots are checked against it as they arrive
+bool addWorkQueueItem(I2COperation operation, const uint8_t *buffer, int bufferSize, uint8_t receiver = 0);
+bool processWorkQueue(); // false when there was nothing to do
+
+size_t getWorkQueueFootprint(); // bytes of static storage
+
+void getWorkQueueStats(WorkQueueStats &stats);
+void printWorkQueueStats();
+void resetWorkQueueStats();
+#ifndef WORKQUEUE_LOGGING
+#define WORKQUEUE_LOGGING 1 // 0 leaves the per item log lines out of the build
+#endif
+
+void setWorkQueueLogging(bool enabled);
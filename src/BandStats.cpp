@@ -0,0 +1,187 @@
+/* Copyright (c) 2025 Paul Winwood, G8KIG - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the GPL-Version 3 license.
+ *
+ * There is a copy of the GPL-Version 3 license in the same folder as this file.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include <Arduino.h>
+
+#include "FrameDecoder.h"
+#include "Bands.h"
+#include "BandStats.h"
+
+static const uint8_t REGISTER_BITS = 5; // log2(DISTINCT_REGISTERS)
+static const uint8_t MAX_RANK = 15;     // largest value a 4 bit register holds
+static_assert(1 << REGISTER_BITS == DISTINCT_REGISTERS, "registers are a power of two");
+
+BandStats::BandStats() : currentHour(NO_HOUR), unbanded(0)
+{
+    memset(buckets, 0, sizeof(buckets));
+    for (int idx = 0; idx < BAND_STATS_HOURS; ++idx)
+        buckets[idx].hour = NO_HOUR;
+}
+
+// Packed callsigns and the FNV hash of short ones are weak in the low bits,
+// so finish them with the murmur3 mix before splitting off a register and
+// a rank
+static uint32_t mix(uint32_t hash)
+{
+    hash ^= hash >> 16;
+    hash *= 0x85EBCA6BU;
+    hash ^= hash >> 13;
+    hash *= 0xC2B2AE35U;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+static uint8_t snrBin(int8_t snr)
+{
+    if (snr < -20)
+        return 0;
+    if (snr >= 10)
+        return SNR_BINS - 1;
+    return (uint8_t)((snr + 25) / 5);
+}
+
+void BandStats::add(uint32_t callsign, uint32_t frequency, int8_t snr, uint32_t now)
+{
+    uint32_t hour = now / 3600;
+    if (hour != currentHour)
+        advance(hour);
+
+    uint8_t band = lookupBand(frequency);
+    if (band == BAND_UNKNOWN)
+    {
+        ++unbanded;
+        return;
+    }
+
+    HourBucket &bucket = buckets[hour % BAND_STATS_HOURS];
+    if (bucket.spots[band] < UINT16_MAX)
+        ++bucket.spots[band];
+    uint16_t &bin = bucket.snr[band][snrBin(snr)];
+    if (bin < UINT16_MAX)
+        ++bin;
+
+    uint32_t hash = mix(callsign);
+    uint8_t reg = hash & (DISTINCT_REGISTERS - 1);
+    uint32_t rest = (hash >> REGISTER_BITS) | (1U << (32 - REGISTER_BITS));
+    uint8_t rank = (uint8_t)__builtin_ctz(rest) + 1;
+    if (rank > MAX_RANK)
+        rank = MAX_RANK;
+    uint8_t &pair = bucket.registers[band][reg / 2];
+    uint8_t shift = (reg & 1) * 4;
+    if (rank > ((pair >> shift) & 0x0F))
+        pair = (uint8_t)((pair & ~(0x0F << shift)) | (rank << shift));
+}
+
+// Starts the bucket for a new hour, clearing those of any hours skipped
+// since the last spot. The first spot, a clock set back, or a gap longer
+// than the window clears them all.
+void BandStats::advance(uint32_t hour)
+{
+    if (currentHour == NO_HOUR || hour < currentHour || hour - currentHour >= BAND_STATS_HOURS)
+    {
+        memset(buckets, 0, sizeof(buckets));
+        for (int idx = 0; idx < BAND_STATS_HOURS; ++idx)
+            buckets[idx].hour = NO_HOUR;
+    }
+    else
+    {
+        for (uint32_t h = currentHour + 1; h < hour; ++h)
+        {
+            memset(buckets + h % BAND_STATS_HOURS, 0, sizeof(HourBucket));
+            buckets[h % BAND_STATS_HOURS].hour = NO_HOUR;
+        }
+    }
+    HourBucket &bucket = buckets[hour % BAND_STATS_HOURS];
+    memset(&bucket, 0, sizeof(bucket));
+    bucket.hour = hour;
+    currentHour = hour;
+}
+
+const BandStats::HourBucket *BandStats::bucketFor(uint8_t hoursAgo) const
+{
+    if (currentHour == NO_HOUR || hoursAgo >= BAND_STATS_HOURS || hoursAgo > currentHour)
+        return NULL;
+    const HourBucket *bucket = buckets + (currentHour - hoursAgo) % BAND_STATS_HOURS;
+    return bucket->hour == currentHour - hoursAgo ? bucket : NULL;
+}
+
+// A sketch of the union of two sets is the larger of each register
+void BandStats::mergeRegisters(const uint8_t *registers, uint8_t *merged)
+{
+    for (uint8_t idx = 0; idx < DISTINCT_REGISTERS / 2; ++idx)
+    {
+        uint8_t low = registers[idx] & 0x0F;
+        uint8_t high = registers[idx] & 0xF0;
+        if ((merged[idx] & 0x0F) > low)
+            low = merged[idx] & 0x0F;
+        if ((merged[idx] & 0xF0) > high)
+            high = merged[idx] & 0xF0;
+        merged[idx] = (uint8_t)(low | high);
+    }
+}
+
+// HyperLogLog, with linear counting while most registers are still empty
+uint32_t BandStats::estimate(const uint8_t *registers)
+{
+    float sum = 0;
+    int zeros = 0;
+    for (uint8_t reg = 0; reg < DISTINCT_REGISTERS; ++reg)
+    {
+        uint8_t rank = (registers[reg / 2] >> ((reg & 1) * 4)) & 0x0F;
+        sum += 1.0f / (1U << rank);
+        zeros += rank == 0;
+    }
+    const float m = DISTINCT_REGISTERS;
+    float estimate = 0.697f * m * m / sum;
+    if (estimate <= 2.5f * m && zeros > 0)
+        estimate = m * logf(m / zeros);
+    return (uint32_t)(estimate + 0.5f);
+}
+
+bool BandStats::hourStats(uint8_t hoursAgo, uint8_t band, BandHourStats &stats) const
+{
+    const HourBucket *bucket = bucketFor(hoursAgo);
+    if (bucket == NULL)
+        return false;
+
+    memset(&stats, 0, sizeof(stats));
+    stats.hour = bucket->hour;
+    uint8_t merged[DISTINCT_REGISTERS / 2];
+    memset(merged, 0, sizeof(merged));
+    for (uint8_t idx = 0; idx < BAND_COUNT; ++idx)
+    {
+        if (band != BAND_UNKNOWN && idx != band)
+            continue;
+        stats.spots += bucket->spots[idx];
+        for (uint8_t bin = 0; bin < SNR_BINS; ++bin)
+            stats.snr[bin] += bucket->snr[idx][bin];
+        mergeRegisters(bucket->registers[idx], merged);
+    }
+    stats.unique = estimate(merged);
+    return true;
+}
+
+uint32_t BandStats::uniqueCallsigns(uint8_t hours, uint8_t band) const
+{
+    uint8_t merged[DISTINCT_REGISTERS / 2];
+    memset(merged, 0, sizeof(merged));
+    for (uint8_t hoursAgo = 0; hoursAgo < hours && hoursAgo < BAND_STATS_HOURS; ++hoursAgo)
+    {
+        const HourBucket *bucket = bucketFor(hoursAgo);
+        if (bucket == NULL)
+            continue;
+        for (uint8_t idx = 0; idx < BAND_COUNT; ++idx)
+        {
+            if (band == BAND_UNKNOWN || idx == band)
+                mergeRegisters(bucket->registers[idx], merged);
+        }
+    }
+    return estimate(merged);
+}
@@ -0,0 +1,24 @@
+/* Copyright (c) 2025 Paul Winwood, G8KIG - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the GPL-Version 3 license.
+ *
+ * There is a copy of the GPL-Version 3 license in the same folder as this file.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "Bands.h"
+
+uint8_t bandFromName(const char *name)
+{
+    if (name != NULL)
+    {
+        for (uint8_t idx = 0; idx < BAND_COUNT; ++idx)
+        {
+            if (strcmp(bands[idx].name, name) == 0)
+                return idx;
+        }
+    }
+    return BAND_UNKNOWN;
+}
@@ -0,0 +1,248 @@
+/* Copyright (c) 2025 Paul Winwood, G8KIG - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the GPL-Version 3 license.
+ *
+ * There is a copy of the GPL-Version 3 license in the same folder as this file.
+ */
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+#include "FrameCapture.h"
+
+static const size_t CAPTURE_PATH_SIZE = 48;
+static const size_t WRITE_CHUNK_SIZE = 512; // at least one whole frame and its header
+
+static uint8_t ring[CAPTURE_RING_SIZE];
+static size_t ringHead = 0;
+static size_t ringCount = 0;
+static uint32_t lastFrameMicros = 0;
+static bool firstFrame = true;
+static volatile bool capturing = false;
+static bool rolloverHeld = false; // a download has the files open
+
+static SemaphoreHandle_t captureMutex = NULL;
+static File captureFile;
+static char path[CAPTURE_PATH_SIZE] = CAPTURE_PATH;
+static char oldPath[CAPTURE_PATH_SIZE + 4] = CAPTURE_PATH ".old";
+static size_t fileSize = 0;
+static CaptureStats stats;
+
+// with the lock held
+static void ringWrite(const uint8_t *data, size_t length)
+{
+    for (size_t idx = 0; idx < length; ++idx)
+        ring[(ringHead + ringCount + idx) % CAPTURE_RING_SIZE] = data[idx];
+    ringCount += length;
+}
+
+static uint8_t ringPeek(size_t offset)
+{
+    return ring[(ringHead + offset) % CAPTURE_RING_SIZE];
+}
+
+static bool startFile()
+{
+    captureFile = LittleFS.open(path, "w");
+    if (!captureFile)
+    {
+        Serial.printf("Cannot create the capture file %s\n", path);
+        return false;
+    }
+    fileSize = captureFile.write(CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC));
+    return true;
+}
+
+bool beginCapture(const char *pathIn)
+{
+    if (capturing)
+        endCapture();
+    if (pathIn == NULL || strlen(pathIn) >= CAPTURE_PATH_SIZE)
+        return false;
+    if (captureMutex == NULL)
+    {
+#ifdef STATIC_ALLOCATION
+        static StaticSemaphore_t captureMutexBuffer;
+        captureMutex = xSemaphoreCreateMutexStatic(&captureMutexBuffer);
+#else
+        captureMutex = xSemaphoreCreateMutex();
+#endif
+    }
+    if (!LittleFS.begin(true))
+    {
+        Serial.println("Cannot mount LittleFS for the capture");
+        return false;
+    }
+
+    strcpy(path, pathIn);
+    snprintf(oldPath, sizeof(oldPath), "%s.old", path);
+    if (!startFile())
+        return false;
+
+    xSemaphoreTake(captureMutex, portMAX_DELAY);
+    ringHead = 0;
+    ringCount = 0;
+    firstFrame = true;
+    memset(&stats, 0, sizeof(stats));
+    capturing = true;
+    xSemaphoreGive(captureMutex);
+    Serial.printf("Capturing frames to %s\n", path);
+    return true;
+}
+
+void endCapture()
+{
+    if (!capturing)
+        return;
+    flushCapture();
+    capturing = false;
+    flushCapture(); // anything that arrived meanwhile
+    captureFile.close();
+    Serial.printf("Capture stopped, %u frames\n", stats.frames);
+}
+
+bool captureActive()
+{
+    return capturing;
+}
+
+const char *capturePath()
+{
+    return path;
+}
+
+const char *captureOldPath()
+{
+    return oldPath;
+}
+
+void captureFrame(const uint8_t *frame, size_t length)
+{
+    if (!capturing || frame == NULL || length == 0 || length > 255)
+        return;
+
+    uint32_t now = micros();
+    xSemaphoreTake(captureMutex, portMAX_DELAY);
+    if (ringCount + CAPTURE_HEADER_SIZE + length > CAPTURE_RING_SIZE)
+    {
+        ++stats.dropped;
+    }
+    else
+    {
+        // a dropped frame's gap is carried by the next one kept
+        uint32_t delta = firstFrame ? 0 : now - lastFrameMicros;
+        uint8_t header[CAPTURE_HEADER_SIZE] = {(uint8_t)delta, (uint8_t)(delta >> 8), (uint8_t)(delta >> 16),
+                                               (uint8_t)(delta >> 24), (uint8_t)length};
+        ringWrite(header, sizeof(header));
+        ringWrite(frame, length);
+        lastFrameMicros = now;
+        firstFrame = false;
+    }
+    xSemaphoreGive(captureMutex);
+}
+
+// The ring is copied out a chunk of whole frames at a time, so the frame
+// handler is not held up by the file system and a new file never starts
+// part way through a frame
+void flushCapture()
+{
+    if (captureMutex == NULL || !captureFile)
+        return;
+
+    while (true)
+    {
+        uint8_t chunk[WRITE_CHUNK_SIZE];
+        size_t used = 0;
+        uint32_t frames = 0;
+        xSemaphoreTake(captureMutex, portMAX_DELAY);
+        while (used < ringCount)
+        {
+            size_t frameSize = CAPTURE_HEADER_SIZE + ringPeek(used + 4);
+            if (used + frameSize > sizeof(chunk))
+                break;
+            for (size_t idx = 0; idx < frameSize; ++idx)
+                chunk[used + idx] = ringPeek(used + idx);
+            used += frameSize;
+            ++frames;
+        }
+        ringHead = (ringHead + used) % CAPTURE_RING_SIZE;
+        ringCount -= used;
+        xSemaphoreGive(captureMutex);
+        if (used == 0)
+            return;
+
+        if (fileSize + used > CAPTURE_FILE_SIZE && !rolloverHeld)
+        {
+            captureFile.close();
+            LittleFS.remove(oldPath);
+            LittleFS.rename(path, oldPath);
+            ++stats.files;
+            if (!startFile())
+            {
+                capturing = false;
+                return;
+            }
+        }
+        fileSize += captureFile.write(chunk, used);
+        stats.frames += frames;
+        stats.bytes += used;
+    }
+}
+
+void holdCaptureRollover(bool hold)
+{
+    rolloverHeld = hold;
+}
+
+const CaptureStats &captureStats()
+{
+    return stats;
+}
+
+void printCaptureStats()
+{
+    Serial.printf("Capture %s: %u frames, %u bytes, %u dropped, %u files started again\n",
+                  capturing ? path : "stopped", stats.frames, stats.bytes, stats.dropped, stats.files);
+}
+
+CaptureReader::CaptureReader()
+{
+}
+
+CaptureReader::~CaptureReader()
+{
+    close();
+}
+
+bool CaptureReader::open(const char *pathIn)
+{
+    close();
+    file = LittleFS.open(pathIn, "r");
+    if (!file)
+        return false;
+    uint8_t magic[sizeof(CAPTURE_MAGIC)];
+    if (file.read(magic, sizeof(magic)) != sizeof(magic) || memcmp(magic, CAPTURE_MAGIC, sizeof(magic)) != 0)
+    {
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool CaptureReader::next(uint32_t &deltaMicros, uint8_t *frame, size_t &length)
+{
+    uint8_t header[CAPTURE_HEADER_SIZE];
+    if (!file || file.read(header, sizeof(header)) != sizeof(header) || header[4] == 0)
+        return false;
+    deltaMicros = header[0] | (uint32_t)header[1] << 8 | (uint32_t)header[2] << 16 | (uint32_t)header[3] << 24;
+    length = header[4];
+    return file.read(frame, length) == length;
+}
+
+void CaptureReader::close()
+{
+    if (file)
+        file.close();
+}
@@ -0,0 +1,131 @@
+/* Copyright (c) 2025 Paul Winwood, G8KIG - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the GPL-Version 3 license.
+ *
+ * There is a copy of the GPL-Version 3 license in the same folder as this file.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "crc.h"
+#include "FrameCodec.h"
+
+// Consistent Overhead Byte Stuffing: each run of non-zero bytes is preceded
+// by a code of its length plus one, which stands for the zero after it
+static size_t cobsEncode(const uint8_t *in, size_t length, uint8_t *out)
+{
+    uint8_t *code = out;
+    uint8_t *p = out + 1;
+    uint8_t run = 1;
+    for (size_t idx = 0; idx < length; ++idx)
+    {
+        if (in[idx] == 0)
+        {
+            *code = run;
+            code = p++;
+            run = 1;
+        }
+        else
+        {
+            *p++ = in[idx];
+            if (++run == 0xFF)
+            {
+                *code = run;
+                code = p++;
+                run = 1;
+            }
+        }
+    }
+    *code = run;
+    return p - out;
+}
+
+// Decoding never writes ahead of where it reads, so in and out may be the
+// same buffer. Returns 0 for a malformed encoding.
+static size_t cobsDecode(const uint8_t *in, size_t length, uint8_t *out)
+{
+    size_t read = 0;
+    size_t written = 0;
+    while (read < length)
+    {
+        uint8_t code = in[read++];
+        if (code == 0 || read + code - 1 > length)
+            return 0;
+        for (uint8_t idx = 1; idx < code; ++idx)
+            out[written++] = in[read++];
+        if (code < 0xFF && read < length)
+            out[written++] = 0;
+    }
+    return written;
+}
+
+size_t encodeFrame(const uint8_t *frame, size_t length, uint8_t *out, size_t outSize)
+{
+    if (length == 0 || length > MAX_FRAME_SIZE || outSize < MAX_ENCODED_FRAME_SIZE)
+        return 0;
+
+    uint8_t body[FRAME_HEADER_SIZE + MAX_FRAME_SIZE + FRAME_TRAILER_SIZE];
+    body[0] = (uint8_t)length;
+    memcpy(body + FRAME_HEADER_SIZE, frame, length);
+    size_t size = cobsEncode(body, appendCrc32(body, FRAME_HEADER_SIZE + length), out);
+    out[size++] = 0;
+    return size;
+}
+
+FrameAssembler::FrameAssembler()
+{
+    reset();
+}
+
+void FrameAssembler::reset()
+{
+    fill = 0;
+    length = 0;
+    discarding = false;
+}
+
+FrameStatus FrameAssembler::push(uint8_t byte)
+{
+    if (byte != 0)
+    {
+        if (discarding)
+            return FRAME_PENDING;
+        if (fill == sizeof(encoded))
+        {
+            fill = 0;
+            discarding = true;
+            return FRAME_OVERRUN;
+        }
+        encoded[fill++] = byte;
+        return FRAME_PENDING;
+    }
+
+    // a delimiter
+    if (discarding)
+    {
+        discarding = false;
+        return FRAME_PENDING;
+    }
+    if (fill == 0)
+        return FRAME_PENDING; // back to back delimiters are allowed
+    return complete();
+}
+
+FrameStatus FrameAssembler::complete()
+{
+    size_t size = cobsDecode(encoded, fill, decoded);
+    fill = 0;
+    if (size < FRAME_HEADER_SIZE + 1 + FRAME_TRAILER_SIZE)
+        return FRAME_CORRUPT;
+
+    size_t frameSize = decoded[0];
+    if (frameSize != size - FRAME_HEADER_SIZE - FRAME_TRAILER_SIZE)
+        return FRAME_CORRUPT;
+
+    if (!checkCrc32(decoded, size))
+        return FRAME_BAD_CRC;
+
+    length = frameSize;
+    return FRAME_READY;
+}
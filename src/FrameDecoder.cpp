@@ -0,0 +1,123 @@
+/* Copyright (c) 2025 Paul Winwood, G8KIG - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the GPL-Version 3 license.
+ *
+ * There is a copy of the GPL-Version 3 license in the same folder as this file.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "FrameDecoder.h"
+#include "PackedCallsign.h"
+
+// Bounded cursor over a received payload
+class FrameReader
+{
+public:
+    FrameReader(const uint8_t *buffer, size_t length)
+        : ptr(buffer), end(buffer + length), valid(buffer != NULL)
+    {
+    }
+
+    bool readString(StringView &view)
+    {
+        uint8_t length = 0;
+        if (!readUint8(length) || !available(length))
+            return false;
+        view.data = reinterpret_cast<const char *>(ptr);
+        view.length = length;
+        ptr += length;
+        return true;
+    }
+
+    bool readUint32(uint32_t &value)
+    {
+        if (!available(sizeof(value)))
+            return false;
+        // frames are not aligned, and are in the transceiver's byte order
+        memcpy(&value, ptr, sizeof(value));
+        ptr += sizeof(value);
+        return true;
+    }
+
+    bool readUint8(uint8_t &value)
+    {
+        if (!available(sizeof(value)))
+            return false;
+        value = *ptr++;
+        return true;
+    }
+
+private:
+    const uint8_t *ptr;
+    const uint8_t *end;
+    bool valid;
+
+    bool available(size_t count)
+    {
+        valid = valid && (size_t)(end - ptr) >= count;
+        return valid;
+    }
+};
+
+static bool isValidCallsign(const StringView &callsign)
+{
+    if (callsign.length == 0 || callsign.length > MAX_CALLSIGN_LENGTH)
+        return false;
+
+    for (uint8_t idx = 0; idx < callsign.length; ++idx)
+    {
+        char ch = callsign.data[idx];
+        if (ch <= ' ' || ch > '~')
+            return false;
+    }
+    return true;
+}
+
+bool StringView::equals(const char *other, size_t otherLength) const
+{
+    return length == otherLength && memcmp(data, other, length) == 0;
+}
+
+bool decodeSenderRecord(const uint8_t *buffer, size_t length, SenderRecordView &record)
+{
+    FrameReader reader(buffer, length);
+    return reader.readString(record.callsign) &&
+           reader.readString(record.gridSquare) &&
+           isValidCallsign(record.callsign);
+}
+
+bool decodeSenderSoftwareRecord(const uint8_t *buffer, size_t length, SenderSoftwareRecordView &record)
+{
+    FrameReader reader(buffer, length);
+    return reader.readString(record.software);
+}
+
+bool decodeReceivedRecord(const uint8_t *buffer, size_t length, ReceivedRecordView &record)
+{
+    FrameReader reader(buffer, length);
+    record.packed = 0;
+    return reader.readString(record.callsign) &&
+           reader.readUint32(record.frequency) &&
+           reader.readUint8(record.snr) &&
+           isValidCallsign(record.callsign);
+}
+
+bool decodePackedReceivedRecord(const uint8_t *buffer, size_t length, ReceivedRecordView &record)
+{
+    FrameReader reader(buffer, length);
+    if (!reader.readUint32(record.packed) ||
+        !reader.readUint32(record.frequency) ||
+        !reader.readUint8(record.snr) ||
+        !isValidPackedCallsign(record.packed))
+        return false;
+
+    if (isStandardCallsign(record.packed))
+    {
+        record.callsign.data = NULL;
+        record.callsign.length = 0;
+        return true;
+    }
+    return reader.readString(record.callsign) && isValidCallsign(record.callsign);
+}
@@ -0,0 +1,88 @@
+/* Copyright (c) 2025 Paul Winwood, G8KIG - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the GPL-Version 3 license.
+ *
+ * There is a copy of the GPL-Version 3 license in the same folder as this file.
+ */
+
+#include <Arduino.h>
+
+#include "FrameCodec.h"
+#include "FrameTransport.h"
+
+FrameTransport::FrameTransport() : wakeupHandler(NULL), frameHandler(NULL), replySource(NULL), context(NULL)
+{
+    memset(&transportStats, 0, sizeof(transportStats));
+}
+
+FrameTransport::~FrameTransport()
+{
+}
+
+void FrameTransport::setHandlers(FrameHandler frameHandlerIn, ReplySource replySourceIn, void *contextIn)
+{
+    frameHandler = frameHandlerIn;
+    replySource = replySourceIn;
+    context = contextIn;
+}
+
+bool FrameTransport::deliverFrame(const uint8_t *frame, size_t length)
+{
+    transportStats.frames++;
+    return frameHandler != NULL && frameHandler(frame, length, context);
+}
+
+size_t FrameTransport::fetchReply(uint8_t *reply, size_t size)
+{
+    if (replySource == NULL)
+        return 0;
+    transportStats.replies++;
+    return replySource(reply, size, context);
+}
+
+void FrameTransport::printStats() const
+{
+    Serial.printf("%s transport: %u frames, %u bytes, %u replies, %u corrupt, %u CRC errors, %u overruns, longest poll %u us\n",
+                  name(), transportStats.frames, transportStats.bytes, transportStats.replies, transportStats.corrupt,
+                  transportStats.crcErrors, transportStats.overruns, transportStats.maxPollMicros);
+}
+
+StreamTransport::StreamTransport()
+{
+}
+
+void StreamTransport::receiveBytes(const uint8_t *data, size_t length)
+{
+    transportStats.bytes += length;
+    for (size_t idx = 0; idx < length; ++idx)
+    {
+        switch (assembler.push(data[idx]))
+        {
+        case FRAME_PENDING:
+            break;
+        case FRAME_READY:
+            if (deliverFrame(assembler.frame(), assembler.frameLength()))
+                sendReply();
+            break;
+        case FRAME_CORRUPT:
+            transportStats.corrupt++;
+            break;
+        case FRAME_BAD_CRC:
+            transportStats.crcErrors++;
+            break;
+        case FRAME_OVERRUN:
+            transportStats.overruns++;
+            break;
+        }
+    }
+}
+
+void StreamTransport::sendReply()
+{
+    uint8_t reply[MAX_FRAME_SIZE];
+    uint8_t encoded[MAX_ENCODED_FRAME_SIZE];
+    size_t length = fetchReply(reply, sizeof(reply));
+    size_t size = encodeFrame(reply, length, encoded, sizeof(encoded));
+    if (size > 0)
+        writeBytes(encoded, size);
+}
@@ -0,0 +1,86 @@
+/* Copyright (c) 2025 Paul Winwood, G8KIG - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the GPL-Version 3 license.
+ *
+ * There is a copy of the GPL-Version 3 license in the same folder as this file.
+ */
+
+#include <Arduino.h>
+#include <Wire.h>
+
+#include "crc.h"
+#include "FrameCodec.h"
+#include "FrameTransport.h"
+#include "I2CTransport.h"
+
+#ifdef I2C_FRAME_CRC
+static const size_t WRITE_TRAILER_SIZE = CRC32_TRAILER_SIZE;
+#else
+static const size_t WRITE_TRAILER_SIZE = 0;
+#endif
+
+I2CTransport *I2CTransport::instance = NULL;
+
+I2CTransport::I2CTransport(uint8_t addressIn) : address(addressIn)
+{
+}
+
+bool I2CTransport::begin()
+{
+    instance = this;
+    bool result = Wire.begin(address);
+    Wire.onReceive(receiveEvent);
+    Wire.onRequest(requestEvent);
+    return result;
+}
+
+void I2CTransport::poll()
+{
+    // frames are delivered from the Wire callbacks as they arrive
+}
+
+// I2C slave API
+void I2CTransport::receiveEvent(int length)
+{
+    if (instance != NULL && length > 0 && Wire.available() > 0)
+    {
+        uint8_t frame[MAX_FRAME_SIZE + WRITE_TRAILER_SIZE] = {0};
+        size_t idx = 0;
+        while (Wire.available() && idx < sizeof(frame))
+            frame[idx++] = Wire.read();
+        bool overrun = false;
+        while (Wire.available())
+        {
+            Wire.read();
+            overrun = true;
+        }
+        instance->transportStats.bytes += idx;
+        // a write longer than any frame is not cut short and delivered
+        if (overrun)
+        {
+            instance->transportStats.overruns++;
+            return;
+        }
+#ifdef I2C_FRAME_CRC
+        if (idx <= CRC32_TRAILER_SIZE || !checkCrc32(frame, idx))
+        {
+            instance->transportStats.crcErrors++;
+            return;
+        }
+        idx -= CRC32_TRAILER_SIZE;
+#endif
+        instance->deliverFrame(frame, idx);
+    }
+}
+
+// I2C slave API
+void I2CTransport::requestEvent()
+{
+    uint8_t reply[MAX_FRAME_SIZE + CRC32_TRAILER_SIZE];
+    size_t length = instance != NULL ? instance->fetchReply(reply, MAX_FRAME_SIZE) : 0;
+#ifdef I2C_FRAME_CRC
+    if (length > 0)
+        length = appendCrc32(reply, length);
+#endif
+    Wire.write(reply, length);
+}
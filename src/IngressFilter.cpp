@@ -0,0 +1,133 @@
+/* Copyright (c) 2025 Paul Winwood, G8KIG - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the GPL-Version 3 license.
+ *
+ * There is a copy of the GPL-Version 3 license in the same folder as this file.
+ */
+
+#include <Arduino.h>
+
+#include "LatencyHistogram.h"
+#include "workqueue.h"
+#include "FrameDecoder.h"
+#include "RecordStore.h"
+#include "IngressFilter.h"
+
+constexpr size_t IngressFilter::FILTER_BITS;
+constexpr size_t IngressFilter::FILTER_WORDS;
+
+IngressFilter::IngressFilter()
+{
+    for (uint8_t receiver = 0; receiver < MAX_RECEIVERS; ++receiver)
+        clear(receiver);
+    resetStats();
+}
+
+// Packed callsigns of nearby stations differ in a few low bits, so the key
+// is mixed (murmur3's finaliser) and split into the two hashes the probes
+// are made from
+static uint32_t mix(uint32_t hash)
+{
+    hash ^= hash >> 16;
+    hash *= 0x85EBCA6BU;
+    hash ^= hash >> 13;
+    hash *= 0xC2B2AE35U;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+bool IngressFilter::contains(uint8_t receiver, uint32_t key) const
+{
+    uint32_t hash = mix(key);
+    uint32_t step = (hash >> 16) | 1;
+    for (int probe = 0; probe < PROBES; ++probe)
+    {
+        uint32_t bit = (hash + probe * step) & (FILTER_BITS - 1);
+        if ((bits[receiver][bit / 32] & (1U << (bit % 32))) == 0)
+            return false;
+    }
+    return true;
+}
+
+bool IngressFilter::checkArrival(uint8_t receiver, uint32_t key, bool dropRepeats)
+{
+    if (receiver >= MAX_RECEIVERS)
+        return false;
+    ++checked;
+    if (!contains(receiver, key))
+        return false;
+    ++matched;
+    if (!dropRepeats)
+        return false;
+    ++dropped;
+    return true;
+}
+
+// Every station added was, a moment before, one the store did not hold, so
+// finding it already in the filter is a false positive
+void IngressFilter::addStation(uint8_t receiver, uint32_t key)
+{
+    if (receiver >= MAX_RECEIVERS)
+        return;
+    ++newStations;
+    if (contains(receiver, key))
+        ++falsePositives;
+
+    uint32_t hash = mix(key);
+    uint32_t step = (hash >> 16) | 1;
+    for (int probe = 0; probe < PROBES; ++probe)
+    {
+        uint32_t bit = (hash + probe * step) & (FILTER_BITS - 1);
+        bits[receiver][bit / 32] = bits[receiver][bit / 32] | (1U << (bit % 32));
+    }
+}
+
+void IngressFilter::clear(uint8_t receiver)
+{
+    if (receiver >= MAX_RECEIVERS)
+        return;
+    for (size_t word = 0; word < FILTER_WORDS; ++word)
+        bits[receiver][word] = 0;
+}
+
+void IngressFilter::getStats(IngressFilterStats &stats) const
+{
+    stats.checked = checked;
+    stats.matched = matched;
+    stats.dropped = dropped;
+    stats.newStations = newStations;
+    stats.falsePositives = falsePositives;
+}
+
+void IngressFilter::resetStats()
+{
+    checked = 0;
+    matched = 0;
+    dropped = 0;
+    newStations = 0;
+    falsePositives = 0;
+}
+
+double IngressFilter::fillRatio() const
+{
+    uint32_t set = 0;
+    for (uint8_t receiver = 0; receiver < MAX_RECEIVERS; ++receiver)
+    {
+        for (size_t word = 0; word < FILTER_WORDS; ++word)
+            set += __builtin_popcount(bits[receiver][word]);
+    }
+    return (double)set / (FILTER_BITS * MAX_RECEIVERS);
+}
+
+void IngressFilter::printStats() const
+{
+    IngressFilterStats stats;
+    getStats(stats);
+    double fill = fillRatio();
+    Serial.printf("ingress filter: %u checked, %u repeats, %u dropped (queue slots saved), %u bytes\n",
+                  stats.checked, stats.matched, stats.dropped, (unsigned)sizeof(bits));
+    Serial.printf("  false positives %u of %u new stations (%.2f%%), %.1f%% of bits set, %.3f%% expected now\n",
+                  stats.falsePositives, stats.newStations,
+                  stats.newStations > 0 ? 100.0 * stats.falsePositives / stats.newStations : 0.0,
+                  100.0 * fill, 100.0 * fill * fill * fill);
+}
@@ -0,0 +1,84 @@
+/* Copyright (c) 2025 Paul Winwood, G8KIG - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the GPL-Version 3 license.
+ *
+ * There is a copy of the GPL-Version 3 license in the same folder as this file.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "LatencyHistogram.h"
+
+LatencyHistogram::LatencyHistogram()
+{
+    reset();
+}
+
+void LatencyHistogram::reset()
+{
+    memset(buckets, 0, sizeof(buckets));
+    samples = 0;
+    maxValue = 0;
+}
+
+int LatencyHistogram::bucketIndex(uint32_t value)
+{
+    if (value < 4)
+        return (int)value;
+
+    int msb = 31 - __builtin_clz(value);
+    int index = (msb - 1) * 4 + (int)((value >> (msb - 2)) & 3);
+    return index < BUCKET_COUNT ? index : BUCKET_COUNT - 1;
+}
+
+uint32_t LatencyHistogram::bucketUpperBound(int index)
+{
+    if (index < 4)
+        return (uint32_t)index;
+
+    int msb = index / 4 + 1;
+    uint32_t lower = (uint32_t)(4 + index % 4) << (msb - 2);
+    return lower + (1U << (msb - 2)) - 1;
+}
+
+void LatencyHistogram::record(uint32_t microseconds)
+{
+    buckets[bucketIndex(microseconds)]++;
+    samples++;
+    if (microseconds > maxValue)
+        maxValue = microseconds;
+}
+
+uint32_t LatencyHistogram::count() const
+{
+    return samples;
+}
+
+uint32_t LatencyHistogram::maximum() const
+{
+    return maxValue;
+}
+
+uint32_t LatencyHistogram::percentile(uint32_t percent) const
+{
+    if (samples == 0)
+        return 0;
+
+    // rank of the sample we are looking for, rounded up
+    uint64_t rank = ((uint64_t)samples * percent + 99) / 100;
+    if (rank == 0)
+        rank = 1;
+
+    uint64_t seen = 0;
+    for (int idx = 0; idx < BUCKET_COUNT; ++idx)
+    {
+        seen += buckets[idx];
+        if (seen >= rank)
+        {
+            uint32_t bound = bucketUpperBound(idx);
+            return bound < maxValue ? bound : maxValue;
+        }
+    }
+    return maxValue;
+}
@@ -0,0 +1,409 @@
+/* Copyright (c) 2025 Paul Winwood, G8KIG - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the GPL-Version 3 license.
+ *
+ * There is a copy of the GPL-Version 3 license in the same folder as this file.
+ */
+
+#include <Arduino.h>
+
+#include "main.h"
+#include "PackedCallsign.h"
+#include "LatencyHistogram.h"
+#include "workqueue.h"
+#include "SafeString.h"
+#include "LoadGenerator.h"
+
+size_t encodeSenderRecord(uint8_t *buffer, size_t bufferSizeIn, const char *callsign, const char *gridSquare)
+{
+    size_t result = 0;
+    size_t callsignLength = strlen(callsign);
+    size_t gridSquareLength = strlen(gridSquare);
+
+    size_t bufferSize = sizeof(uint8_t) + callsignLength + sizeof(uint8_t) + gridSquareLength;
+    if (bufferSize < bufferSizeIn)
+    {
+        uint8_t *ptr = buffer;
+        // Add callsign as length-delimited
+        *ptr++ = (uint8_t)callsignLength;
+        memcpy(ptr, callsign, callsignLength);
+        ptr += callsignLength;
+
+        // Add gridSquare as length-delimited
+        *ptr++ = (uint8_t)gridSquareLength;
+        memcpy(ptr, gridSquare, gridSquareLength);
+        ptr += gridSquareLength;
+        result = ptr - buffer;
+    }
+    return result;
+}
+
+size_t encodeSenderSoftwareRecord(uint8_t *buffer, size_t bufferSizeIn, const char *software)
+{
+    size_t result = 0;
+    size_t softwareLength = strlen(software);
+
+    size_t bufferSize = sizeof(uint8_t) + softwareLength;
+    if (bufferSize < bufferSizeIn)
+    {
+        uint8_t *ptr = buffer;
+        // Add software as length-delimited
+        *ptr++ = (uint8_t)softwareLength;
+        memcpy(ptr, software, softwareLength);
+        ptr += softwareLength;
+
+        result = ptr - buffer;
+    }
+    return result;
+}
+
+size_t encodeReceivedRecord(uint8_t *buffer, size_t bufferSizeIn, const char *callsign, uint32_t frequency, uint8_t snr)
+{
+    size_t result = 0;
+    size_t callsignLength = strlen(callsign);
+    size_t bufferSize = sizeof(uint8_t) + callsignLength + sizeof(uint32_t) + sizeof(uint8_t);
+    if (bufferSize < bufferSizeIn)
+    {
+        uint8_t *ptr = buffer;
+        // Add callsign as length-delimited
+        *ptr++ = (uint8_t)callsignLength;
+        memcpy(ptr, callsign, callsignLength);
+        ptr += (uint8_t)callsignLength;
+
+        // Add frequency
+        memcpy(ptr, &frequency, sizeof(frequency));
+        ptr += sizeof(frequency);
+
+        // Add SNR (1 byte)
+        *ptr++ = snr;
+
+        result = ptr - buffer;
+    }
+    return result;
+}
+
+// FT8's 22 bit hash of a callsign it cannot pack, as the transceiver would
+// send it in place of the callsign
+static uint32_t hashCallsign(const char *callsign, size_t length)
+{
+    static const char alphabet[] = " 0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ/";
+    uint64_t n = 0;
+    for (size_t idx = 0; idx < 11; ++idx)
+    {
+        const char *position = idx < length ? strchr(alphabet, callsign[idx]) : NULL;
+        n = n * 38 + (position != NULL ? position - alphabet : 0);
+    }
+    return (uint32_t)((47055833459ULL * n) >> (64 - 22));
+}
+
+size_t encodePackedReceivedRecord(uint8_t *buffer, size_t bufferSizeIn, const char *callsign, uint32_t frequency, uint8_t snr)
+{
+    size_t callsignLength = strlen(callsign);
+    uint32_t packed;
+    bool standard = packCallsign(callsign, callsignLength, packed);
+    if (!standard)
+        packed = C28_TOKENS + hashCallsign(callsign, callsignLength);
+
+    size_t bufferSize = sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint8_t);
+    if (!standard)
+        bufferSize += sizeof(uint8_t) + callsignLength;
+    if (bufferSize >= bufferSizeIn)
+        return 0;
+
+    uint8_t *ptr = buffer;
+    memcpy(ptr, &packed, sizeof(packed));
+    ptr += sizeof(packed);
+    memcpy(ptr, &frequency, sizeof(frequency));
+    ptr += sizeof(frequency);
+    *ptr++ = snr;
+
+    // only the transceiver knows the callsign behind a hash
+    if (!standard)
+    {
+        *ptr++ = (uint8_t)callsignLength;
+        memcpy(ptr, callsign, callsignLength);
+        ptr += callsignLength;
+    }
+    return ptr - buffer;
+}
+
+static const char *const callsignPrefixes[] = {
+    "G", "M", "2E", "EI", "DL", "F", "EA", "I", "PA", "ON",
+    "SM", "OH", "SP", "OK", "K", "W", "N", "VE", "JA", "VK"};
+static const int PREFIX_COUNT = sizeof(callsignPrefixes) / sizeof(callsignPrefixes[0]);
+
+uint32_t nextRandom(uint32_t &state)
+{
+    // xorshift32 - deterministic for a given seed
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+// Station numbers map onto unique, plausible callsigns such as "DL3ABC"
+void stationCallsign(uint32_t station, char *callsign)
+{
+    const char *prefix = callsignPrefixes[station % PREFIX_COUNT];
+    uint32_t digit = (station / PREFIX_COUNT) % 10;
+    uint32_t suffix = station / (PREFIX_COUNT * 10);
+    char letters[4];
+    letters[0] = 'A' + (suffix / 676) % 26;
+    letters[1] = 'A' + (suffix / 26) % 26;
+    letters[2] = 'A' + suffix % 26;
+    letters[3] = 0;
+    sprintf(callsign, "%s%u%s", prefix, (unsigned)digit, letters);
+}
+
+// Stations keep the same audio offset and a similar signal level between slots
+uint32_t stationHash(uint32_t station)
+{
+    uint32_t hash = station * 2654435761U;
+    return hash ^ (hash >> 15);
+}
+
+// SafeString::Format as it was, sizing with one vsnprintf and writing with
+// a second into a new buffer whenever the string has to grow
+static bool twoPassFormat(SafeString &string, const char *fmt, ...)
+{
+    va_list args, sizeArgs;
+    va_start(args, fmt);
+    va_copy(sizeArgs, args);
+    int size = vsnprintf(NULL, 0, fmt, sizeArgs);
+    va_end(sizeArgs);
+    if (size < 0)
+    {
+        va_end(args);
+        return false;
+    }
+    if (string.length() >= (size_t)size)
+    {
+        vsnprintf(string.get(), size + 1, fmt, args);
+    }
+    else
+    {
+        SafeString temp((size_t)size);
+        vsnprintf(temp.get(), size + 1, fmt, args);
+        string = temp;
+    }
+    va_end(args);
+    return true;
+}
+
+static const char SPOT_LINE_FORMAT[] = "%s %8.3f MHz %+3d dB %5u Hz";
+static const char SPOT_JSON_FORMAT[] = "{\"callsign\":\"%s\",\"frequency\":%u,\"snr\":%d},";
+static const int JSON_SPOTS = 50;
+
+// Nanoseconds a spot line, formatted into a new string or reusing one
+static double timeSpotLines(uint32_t rounds, bool twoPass, bool reuse, const char *callsigns[])
+{
+    SafeString line;
+    volatile size_t total = 0;
+    unsigned long started = micros();
+    for (uint32_t round = 0; round < rounds; ++round)
+    {
+        uint32_t hash = stationHash(round);
+        SafeString fresh;
+        SafeString &target = reuse ? line : fresh;
+        if (twoPass)
+            twoPassFormat(target, SPOT_LINE_FORMAT, callsigns[round % 16], 14.074 + (hash % 3000) / 1e6,
+                          (int)(hash % 50) - 25, (unsigned)(hash % 3000));
+        else
+            target.Format(SPOT_LINE_FORMAT, callsigns[round % 16], 14.074 + (hash % 3000) / 1e6,
+                          (int)(hash % 50) - 25, (unsigned)(hash % 3000));
+        total = total + target.length();
+    }
+    return (micros() - started) * 1000.0 / rounds;
+}
+
+// A JSON array of spots, built by formatting the whole document again for
+// each spot, which was all the old API allowed, or by appending
+static double timeSpotDocuments(uint32_t rounds, bool builder, const char *callsigns[], size_t &length)
+{
+    SafeString document;
+    unsigned long started = micros();
+    for (uint32_t round = 0; round < rounds; ++round)
+    {
+        if (builder)
+        {
+            document.clear();
+            document.append("[");
+        }
+        else
+        {
+            document = SafeString("[");
+        }
+        for (int spot = 0; spot < JSON_SPOTS; ++spot)
+        {
+            uint32_t hash = stationHash(round * JSON_SPOTS + spot);
+            if (builder)
+            {
+                document.appendFormat(SPOT_JSON_FORMAT, callsigns[spot % 16], 14074000 + hash % 3000,
+                                      (int)(hash % 50) - 25);
+            }
+            else
+            {
+                SafeString entry;
+                twoPassFormat(entry, SPOT_JSON_FORMAT, callsigns[spot % 16], 14074000 + hash % 3000,
+                              (int)(hash % 50) - 25);
+                SafeString previous = document;
+                twoPassFormat(document, "%s%s", previous.c_str(), entry.c_str());
+            }
+        }
+        length = document.length();
+    }
+    return (micros() - started) * 1000.0 / rounds;
+}
+
+void benchmarkStringBuilding(uint32_t rounds)
+{
+    if (rounds == 0)
+        return;
+    char callsignText[16][12];
+    const char *callsigns[16];
+    for (int i = 0; i < 16; ++i)
+    {
+        stationCallsign(stationHash(i) % 100000, callsignText[i]);
+        callsigns[i] = callsignText[i];
+    }
+
+    Serial.printf("String building, %u rounds\n", rounds);
+    Serial.printf("  spot line, new string:    two pass Format %.0f ns, Format %.0f ns\n",
+                  timeSpotLines(rounds, true, false, callsigns), timeSpotLines(rounds, false, false, callsigns));
+    Serial.printf("  spot line, reused string: two pass Format %.0f ns, Format %.0f ns\n",
+                  timeSpotLines(rounds, true, true, callsigns), timeSpotLines(rounds, false, true, callsigns));
+    uint32_t documents = rounds / JSON_SPOTS > 0 ? rounds / JSON_SPOTS : 1;
+    size_t oldLength = 0, newLength = 0;
+    double oldNanos = timeSpotDocuments(documents, false, callsigns, oldLength);
+    double newNanos = timeSpotDocuments(documents, true, callsigns, newLength);
+    Serial.printf("  %d spot JSON document:    reformatting %.0f ns, appendFormat %.0f ns (%u and %u bytes)\n",
+                  JSON_SPOTS, oldNanos, newNanos, (unsigned)oldLength, (unsigned)newLength);
+}
+
+// On a board only in a TESTING build; the Linux daemon always has it
+#if defined(TESTING) || !defined(ESP_PLATFORM)
+
+static const int RECENT_STATIONS = 64;
+static const uint32_t BACK_TO_BACK_DRAIN_MS = 15000; // when there is no slot period to drain in
+
+static void sendFrame(I2COperation operation, const uint8_t *payload, size_t payloadLength)
+{
+    uint8_t frame[BUFFER_SIZE];
+    frame[0] = (uint8_t)operation;
+    if (payloadLength > 0)
+        memcpy(frame + 1, payload, payloadLength);
+    handleReceivedFrame(frame, payloadLength + 1);
+}
+
+static void waitForQueueToDrain(uint32_t timeoutMs)
+{
+    WorkQueueStats stats;
+    unsigned long start = millis();
+    for (;;)
+    {
+        getWorkQueueStats(stats);
+        if ((stats.lanes[LANE_CONTROL].depth == 0 && stats.lanes[LANE_BULK].depth == 0) ||
+            millis() - start >= timeoutMs)
+            break;
+        delay(1);
+    }
+}
+
+void runLoadGenerator(const LoadGeneratorConfig &config, LoadGeneratorReport &report)
+{
+    uint32_t random = config.seed != 0 ? config.seed : 1;
+    uint32_t recent[RECENT_STATIONS];
+    int recentCount = 0;
+    uint8_t payload[BUFFER_SIZE - 1];
+    size_t size;
+
+    report.framesOffered = 0;
+    report.elapsedMs = 0;
+    report.busyMicros = 0;
+
+    setWorkQueueLogging(false);
+
+    size = encodeSenderRecord(payload, sizeof(payload), "G8KIG", "IO91iq");
+    sendFrame(OP_SENDER_RECORD, payload, size);
+    size = encodeSenderSoftwareRecord(payload, sizeof(payload), "DX FT8 Transceiver (Test)");
+    sendFrame(OP_SENDER_SOFTWARE_RECORD, payload, size);
+    waitForQueueToDrain(1000);
+    resetWorkQueueStats();
+
+    uint32_t drainMs = config.slotPeriodMs > 0 ? config.slotPeriodMs : BACK_TO_BACK_DRAIN_MS;
+    unsigned long runStart = millis();
+    for (uint16_t slot = 0; slot < config.slots; ++slot)
+    {
+        // wait for the next slot boundary
+        unsigned long slotStart = config.slotPeriodMs > 0 ? runStart + (unsigned long)slot * config.slotPeriodMs : millis();
+        while ((long)(millis() - slotStart) < 0)
+            delay(1);
+
+        unsigned long burstStartMicros = micros();
+        for (uint16_t decode = 0; decode < config.burstSize; ++decode)
+        {
+            unsigned long due = slotStart + (unsigned long)decode * config.burstWindowMs / config.burstSize;
+            while ((long)(millis() - due) < 0)
+                delay(1);
+
+            // Most decodes come from a few strong, active stations
+            uint32_t station;
+            if (recentCount > 0 && nextRandom(random) % 100 < config.repeatPercent)
+            {
+                station = recent[nextRandom(random) % recentCount];
+            }
+            else
+            {
+                uint32_t u = nextRandom(random) % 1024;
+                station = (u * u * config.stationCount) >> 20;
+                if (recentCount < RECENT_STATIONS)
+                    recent[recentCount++] = station;
+                else
+                    recent[nextRandom(random) % RECENT_STATIONS] = station;
+            }
+
+            char callsign[16];
+            stationCallsign(station, callsign);
+            uint32_t hash = stationHash(station);
+            uint32_t frequency = config.baseFrequency + 200 + hash % 2800;
+            int snr = -20 + (int)((hash >> 12) % 26) + (int)(nextRandom(random) % 7) - 3;
+
+            size = encodeReceivedRecord(payload, sizeof(payload), callsign, frequency, (uint8_t)(int8_t)snr);
+            sendFrame(OP_RECEIVER_RECORD, payload, size);
+            report.framesOffered++;
+        }
+
+        waitForQueueToDrain(drainMs);
+        report.busyMicros += micros() - burstStartMicros;
+    }
+
+    if (config.flushAtEnd)
+    {
+        sendFrame(OP_SEND_REQUEST, NULL, 0);
+        waitForQueueToDrain(drainMs);
+    }
+
+    report.elapsedMs = millis() - runStart;
+    getWorkQueueStats(report.queue);
+    setWorkQueueLogging(true);
+}
+
+void printLoadGeneratorReport(const LoadGeneratorConfig &config, const LoadGeneratorReport &report)
+{
+    const WorkLaneStats &spots = report.queue.lanes[LANE_BULK];
+    const WorkLaneStats &control = report.queue.lanes[LANE_CONTROL];
+    float sustained = report.busyMicros > 0 ? spots.processed * 1000000.0f / report.busyMicros : 0.0f;
+
+    Serial.printf("Load test: %u slots of %u decodes in %u ms, %u%% repeats, %u stations\n",
+                  config.slots, config.burstSize, config.burstWindowMs, config.repeatPercent, config.stationCount);
+    Serial.printf("  offered %u frames in %u ms\n", report.framesOffered, report.elapsedMs);
+    Serial.printf("  queued %u, dropped %u (queue full), processed %u\n", spots.queued, spots.dropped, spots.processed);
+    Serial.printf("  sustained %.1f records/s while busy, queue high water %d of %d\n", sustained, spots.highWater, spots.capacity);
+    Serial.printf("  latency us: p50 %u p90 %u p99 %u max %u\n",
+                  spots.latency.percentile(50), spots.latency.percentile(90),
+                  spots.latency.percentile(99), spots.latency.maximum());
+    Serial.printf("  control: queued %u, coalesced %u, dropped %u, p99 latency %u us\n",
+                  control.queued, control.coalesced, control.dropped, control.latency.percentile(99));
+}
+
+#endif
@@ -0,0 +1,493 @@
+/* Copyright (c) 2025 Paul Winwood, G8KIG - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the GPL-Version 3 license.
+ *
+ * There is a copy of the GPL-Version 3 license in the same folder as this file.
+ */
+
+#include <WiFi.h>
+#include <WiFiManager.h>
+#include <esp_wifi.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <unistd.h>
+
+#include "WiFiCache.h"
+#include "NetworkService.h"
+
+static const char *const PORTAL_SSID = "DX_FT8_Xceiver";
+static const uint32_t FAST_RECONNECT_TIMEOUT_MS = 5000;
+static const uint32_t STORED_RECONNECT_TIMEOUT_MS = 15000; // DHCP and any channel
+static const uint32_t LINK_CHECK_MS = 1000;
+static const uint32_t DHCP_TIMEOUT_MS = 15000; // for a lease after joining on the cached one
+static const uint32_t CONNECTING_POLL_MS = 50; // joining, scanning or serving the portal
+static const uint32_t NTP_POLL_MS = 10;        // while a reply is due, half of it is error
+static const uint32_t NTP_TIMEOUT_MS = 1000;
+static const uint32_t NTP_RETRY_MS = 10000;
+static const uint32_t NTP_RESOLVE_INTERVAL_MS = 600000;
+static const uint16_t NTP_PORT = 123;
+static const size_t NTP_PACKET_SIZE = 48;
+static const uint32_t NTP_UNIX_OFFSET = 2208988800UL; // 1900 to 1970
+
+enum LinkState
+{
+    LINK_DOWN = 0,
+    LINK_JOINING_CACHED, // the cached access point and lease
+    LINK_JOINING,        // the stored credentials, on any channel
+    LINK_SCANNING,       // listing the networks before the portal
+    LINK_PORTAL,
+    LINK_UP
+};
+static const char *const linkStateNames[] = {"down", "joining cached", "joining", "scanning", "portal", "up"};
+
+// Deadlines in millis(), only looked at in the states that use them
+enum NetworkTimer
+{
+    TIMER_LINK = 0, // join timeout, or the next check of a link that is up
+    TIMER_NTP,      // next request, or the reply timeout
+    TIMER_COUNT
+};
+
+static LinkState linkState = LINK_DOWN;
+static unsigned long deadlines[TIMER_COUNT];
+static NetworkTimeHandler timeHandler = NULL;
+static NetworkStats stats;
+static volatile bool scanRequested = false;
+static bool scanning = false;
+static bool leasePending = false; // joined on the cached address, DHCP not yet answered
+
+static int ntpSocket = -1;
+static bool ntpWaiting = false;
+static IPAddress ntpAddress;
+static unsigned long ntpResolvedMs = 0;
+static uint32_t ntpSentMicros;
+static uint8_t ntpNonce[8];
+
+static void arm(NetworkTimer timer, uint32_t delayMs)
+{
+    deadlines[timer] = millis() + delayMs;
+}
+
+static bool expired(NetworkTimer timer, unsigned long now)
+{
+    return (long)(now - deadlines[timer]) >= 0;
+}
+
+static uint32_t untilDue(NetworkTimer timer, unsigned long now)
+{
+    return expired(timer, now) ? 0 : deadlines[timer] - now;
+}
+
+// One portal for the life of the task, it is only serviced when running
+static WiFiManager &portal()
+{
+    static WiFiManager manager;
+    return manager;
+}
+
+void beginNetworkService(NetworkTimeHandler handler)
+{
+    timeHandler = handler;
+    memset(&stats, 0, sizeof(stats));
+    linkState = LINK_DOWN;
+    arm(TIMER_LINK, 0);
+}
+
+void requestNetworkScan()
+{
+    scanRequested = true;
+}
+
+const NetworkStats &networkStats()
+{
+    return stats;
+}
+
+static void printScan(int16_t found)
+{
+    if (found <= 0)
+    {
+        Serial.println(found == 0 ? "no networks found" : "network scan failed");
+        return;
+    }
+
+    Serial.printf("%d networks found\n", found);
+    Serial.println("Nr | SSID                             | RSSI | CH | Encryption");
+    for (int i = 0; i < found; ++i)
+    {
+        const char *encryption;
+        switch (WiFi.encryptionType(i))
+        {
+        case WIFI_AUTH_OPEN:
+            encryption = "open";
+            break;
+        case WIFI_AUTH_WEP:
+            encryption = "WEP";
+            break;
+        case WIFI_AUTH_WPA_PSK:
+            encryption = "WPA";
+            break;
+        case WIFI_AUTH_WPA2_PSK:
+            encryption = "WPA2";
+            break;
+        case WIFI_AUTH_WPA_WPA2_PSK:
+            encryption = "WPA+WPA2";
+            break;
+        case WIFI_AUTH_WPA2_ENTERPRISE:
+            encryption = "WPA2-EAP";
+            break;
+        case WIFI_AUTH_WPA3_PSK:
+            encryption = "WPA3";
+            break;
+        case WIFI_AUTH_WPA2_WPA3_PSK:
+            encryption = "WPA2+WPA3";
+            break;
+        case WIFI_AUTH_WAPI_PSK:
+            encryption = "WAPI";
+            break;
+        default:
+            encryption = "unknown";
+        }
+        Serial.printf("%2d | %-32.32s | %4d | %2d | %s\n",
+                      i + 1, WiFi.SSID(i).c_str(), (int)WiFi.RSSI(i), (int)WiFi.channel(i), encryption);
+    }
+    Serial.println();
+}
+
+// True once a scan, started here or from requestNetworkScan(), has finished
+static bool serviceScan()
+{
+    if (!scanning && scanRequested)
+    {
+        scanRequested = false;
+        scanning = WiFi.scanNetworks(true) == WIFI_SCAN_RUNNING;
+    }
+    if (!scanning)
+        return true;
+
+    int16_t found = WiFi.scanComplete();
+    if (found == WIFI_SCAN_RUNNING)
+        return false;
+    printScan(found);
+    WiFi.scanDelete();
+    scanning = false;
+    return true;
+}
+
+static void closeNtpSocket()
+{
+    if (ntpSocket >= 0)
+        close(ntpSocket);
+    ntpSocket = -1;
+    ntpWaiting = false;
+}
+
+// A join on the cached address hands it straight back to DHCP, so the
+// lease is renewed, or replaced, like any other; the link counts as up
+// from the join, but the cache and NTP wait for the new lease
+static void linkUp(bool cachedLease)
+{
+    if (linkState == LINK_PORTAL && portal().getConfigPortalActive())
+        portal().stopConfigPortal();
+    linkState = LINK_UP;
+    ++stats.connects;
+    Serial.print("WiFi connected, IP address: ");
+    Serial.println(WiFi.localIP());
+    if (stats.connectedAfterBootMs == 0)
+    {
+        stats.connectedAfterBootMs = millis();
+        Serial.printf("Connected %lu ms after boot\n", stats.connectedAfterBootMs);
+    }
+    leasePending = cachedLease;
+    if (cachedLease)
+    {
+        resumeDhcp();
+        arm(TIMER_LINK, DHCP_TIMEOUT_MS);
+        return;
+    }
+    saveCachedConnection();
+    arm(TIMER_LINK, LINK_CHECK_MS);
+    arm(TIMER_NTP, 0);
+}
+
+// Once DHCP has answered after a join on the cached address
+static void leaseBound()
+{
+    leasePending = false;
+    Serial.print("DHCP lease, IP address: ");
+    Serial.println(WiFi.localIP());
+    saveCachedConnection();
+    arm(TIMER_LINK, LINK_CHECK_MS);
+    arm(TIMER_NTP, 0);
+}
+
+static void linkDown()
+{
+    Serial.println("WiFi disconnected");
+    ++stats.disconnects;
+    closeNtpSocket();
+    leasePending = false;
+    linkState = LINK_DOWN;
+    arm(TIMER_LINK, 0);
+}
+
+// Joins with the credentials the portal stored, without the cached
+// channel and lease; false if there are none
+static bool beginStoredReconnect()
+{
+    wifi_config_t config;
+    if (esp_wifi_get_config(WIFI_IF_STA, &config) != ESP_OK || config.sta.ssid[0] == 0)
+        return false;
+    WiFi.begin((const char *)config.sta.ssid, (const char *)config.sta.password);
+    return true;
+}
+
+static void startPortal()
+{
+    ++stats.portals;
+    Serial.printf("Starting the configuration portal on %s\n", PORTAL_SSID);
+    // whatever network the portal is given, the cached one is stale
+    clearCachedConnection();
+    WiFiManager &manager = portal();
+    manager.setConfigPortalBlocking(false);
+    manager.startConfigPortal(PORTAL_SSID);
+    linkState = LINK_PORTAL;
+}
+
+static void startScan()
+{
+    // only worth listing the networks when the stored ones failed
+    requestNetworkScan();
+    linkState = LINK_SCANNING;
+}
+
+static void serviceLink(unsigned long now)
+{
+    switch (linkState)
+    {
+    case LINK_DOWN:
+        if (!expired(TIMER_LINK, now))
+            break;
+        if (beginFastReconnect())
+        {
+            linkState = LINK_JOINING_CACHED;
+            arm(TIMER_LINK, FAST_RECONNECT_TIMEOUT_MS);
+        }
+        else if (beginStoredReconnect())
+        {
+            linkState = LINK_JOINING;
+            arm(TIMER_LINK, STORED_RECONNECT_TIMEOUT_MS);
+        }
+        else
+        {
+            startScan();
+        }
+        break;
+
+    case LINK_JOINING_CACHED:
+    case LINK_JOINING:
+        if (WiFi.status() == WL_CONNECTED)
+        {
+            bool cachedLease = linkState == LINK_JOINING_CACHED;
+            if (cachedLease)
+                ++stats.fastReconnects;
+            linkUp(cachedLease);
+        }
+        else if (expired(TIMER_LINK, now))
+        {
+            abandonFastReconnect();
+            // the access point has moved or gone, so stop trying it first
+            if (linkState == LINK_JOINING_CACHED)
+                clearCachedConnection();
+            if (linkState == LINK_JOINING_CACHED && beginStoredReconnect())
+            {
+                linkState = LINK_JOINING;
+                arm(TIMER_LINK, STORED_RECONNECT_TIMEOUT_MS);
+            }
+            else
+            {
+                startScan();
+            }
+        }
+        break;
+
+    case LINK_SCANNING:
+        if (!scanning && !scanRequested)
+            startPortal();
+        break;
+
+    case LINK_PORTAL:
+        // the portal joins the network itself once it is given one
+        if (portal().process() || WiFi.status() == WL_CONNECTED)
+            linkUp(false);
+        break;
+
+    case LINK_UP:
+        if (leasePending)
+        {
+            if (WiFi.status() == WL_CONNECTED && (uint32_t)WiFi.localIP() != 0)
+                leaseBound();
+            else if (expired(TIMER_LINK, now))
+                linkDown();
+        }
+        else if (expired(TIMER_LINK, now))
+        {
+            if (WiFi.status() != WL_CONNECTED)
+                linkDown();
+            else
+                arm(TIMER_LINK, LINK_CHECK_MS);
+        }
+        break;
+    }
+}
+
+static uint32_t readBigEndian32(const uint8_t *data)
+{
+    return (uint32_t)data[0] << 24 | (uint32_t)data[1] << 16 | (uint32_t)data[2] << 8 | data[3];
+}
+
+static bool sendNtpRequest(unsigned long now)
+{
+    if (ntpResolvedMs == 0 || now - ntpResolvedMs > NTP_RESOLVE_INTERVAL_MS)
+    {
+        IPAddress resolved;
+        if (WiFi.hostByName(NTP_SERVER, resolved) != 1 || (uint32_t)resolved == 0)
+            return false;
+        ntpAddress = resolved;
+        ntpResolvedMs = millis() | 1;
+    }
+
+    // kept open while the link is up, and never blocks
+    if (ntpSocket < 0)
+    {
+        ntpSocket = socket(AF_INET, SOCK_DGRAM, 0);
+        if (ntpSocket < 0)
+            return false;
+    }
+
+    // version 4, client. The transmit time is random; the server echoes it
+    // as the originate time, which ties the reply to this request.
+    uint8_t packet[NTP_PACKET_SIZE];
+    memset(packet, 0, sizeof(packet));
+    packet[0] = 0x23;
+    uint32_t nonce[2] = {esp_random(), esp_random()};
+    memcpy(ntpNonce, nonce, sizeof(ntpNonce));
+    memcpy(packet + 40, ntpNonce, sizeof(ntpNonce));
+
+    sockaddr_in server;
+    memset(&server, 0, sizeof(server));
+    server.sin_family = AF_INET;
+    server.sin_port = htons(NTP_PORT);
+    server.sin_addr.s_addr = (uint32_t)ntpAddress;
+    if (sendto(ntpSocket, packet, sizeof(packet), 0, (const sockaddr *)&server, sizeof(server)) != (ssize_t)sizeof(packet))
+    {
+        closeNtpSocket();
+        ntpResolvedMs = 0;
+        return false;
+    }
+    ntpSentMicros = micros();
+    ++stats.ntpRequests;
+    return true;
+}
+
+// Reads whatever has arrived; true when a reply set the time
+static bool receiveNtpReply()
+{
+    uint8_t packet[NTP_PACKET_SIZE];
+    sockaddr_in from;
+    socklen_t fromLength = sizeof(from);
+    ssize_t length;
+    while ((length = recvfrom(ntpSocket, packet, sizeof(packet), MSG_DONTWAIT, (sockaddr *)&from, &fromLength)) >= 0)
+    {
+        uint32_t roundTripMs = (micros() - ntpSentMicros) / 1000;
+        uint8_t leap = packet[0] >> 6;
+        uint8_t mode = packet[0] & 0x07;
+        uint8_t stratum = packet[1];
+        if (length < (ssize_t)NTP_PACKET_SIZE || from.sin_addr.s_addr != (uint32_t)ntpAddress ||
+            from.sin_port != htons(NTP_PORT) || mode != 4 || leap == 3 || stratum == 0 || stratum > 15 ||
+            memcmp(packet + 24, ntpNonce, sizeof(ntpNonce)) != 0)
+        {
+            ++stats.ntpRejected;
+            fromLength = sizeof(from);
+            continue;
+        }
+
+        // the server's transmit time, plus half the round trip
+        uint32_t seconds = readBigEndian32(packet + 40) - NTP_UNIX_OFFSET;
+        uint32_t milliseconds = (uint32_t)(((uint64_t)readBigEndian32(packet + 44) * 1000) >> 32) + roundTripMs / 2;
+        seconds += milliseconds / 1000;
+        if (timeHandler != NULL)
+            timeHandler(seconds, (uint16_t)(milliseconds % 1000));
+        ++stats.ntpReplies;
+        stats.ntpRoundTripMs = roundTripMs;
+        stats.lastTimeUpdateMs = millis() | 1;
+        return true;
+    }
+    return false;
+}
+
+static void serviceNtp(unsigned long now)
+{
+    if (ntpWaiting)
+    {
+        if (receiveNtpReply())
+        {
+            ntpWaiting = false;
+            arm(TIMER_NTP, NTP_INTERVAL_MS);
+        }
+        else if (expired(TIMER_NTP, now))
+        {
+            // the server may have gone, so look it up again next time
+            ntpWaiting = false;
+            ntpResolvedMs = 0;
+            ++stats.ntpTimeouts;
+            arm(TIMER_NTP, NTP_RETRY_MS);
+        }
+    }
+    else if (expired(TIMER_NTP, now))
+    {
+        ntpWaiting = sendNtpRequest(now);
+        arm(TIMER_NTP, ntpWaiting ? NTP_TIMEOUT_MS : NTP_RETRY_MS);
+    }
+}
+
+uint32_t serviceNetwork()
+{
+    unsigned long now = millis();
+    bool scanned = serviceScan();
+    serviceLink(now);
+    if (linkState == LINK_UP && !leasePending)
+        serviceNtp(now);
+
+    if (!scanned)
+        return CONNECTING_POLL_MS;
+    switch (linkState)
+    {
+    case LINK_DOWN:
+        return untilDue(TIMER_LINK, now);
+    case LINK_UP:
+    {
+        if (leasePending)
+            return CONNECTING_POLL_MS;
+        if (ntpWaiting)
+            return NTP_POLL_MS;
+        uint32_t link = untilDue(TIMER_LINK, now);
+        uint32_t ntp = untilDue(TIMER_NTP, now);
+        return link < ntp ? link : ntp;
+    }
+    default:
+        return CONNECTING_POLL_MS;
+    }
+}
+
+void printNetworkStats()
+{
+    Serial.printf("Network: link %s, %u connects (%u to the cached access point), %u disconnects, %u portals\n",
+                  linkStateNames[linkState], stats.connects, stats.fastReconnects, stats.disconnects, stats.portals);
+    Serial.printf("NTP %s: %u requests, %u replies, %u timeouts, %u rejected, last round trip %u ms",
+                  NTP_SERVER, stats.ntpRequests, stats.ntpReplies, stats.ntpTimeouts, stats.ntpRejected, stats.ntpRoundTripMs);
+    if (stats.lastTimeUpdateMs != 0)
+        Serial.printf(", updated %lu s ago\n", (millis() - stats.lastTimeUpdateMs) / 1000);
+    else
+        Serial.println(", never updated");
+}
@@ -7,6 +7,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <errno.h>
 #include <time.h>
 
@@ -18,16 +19,19 @@
 
 #include <WiFi.h>
 
-#include "SafeString.h"
+#include "LatencyHistogram.h"
+#include "workqueue.h"
+#include "FrameDecoder.h"
+#include "PackedCallsign.h"
+#include "RecordStore.h"
+#include "Bands.h"
+#include "SpotHistory.h"
+#include "BandStats.h"
+#include "IngressFilter.h"
+#include "SpotSink.h"
 #include "PSKReporter.h"
 #include "main.h"
 
-constexpr auto PSK_REPORTER_HOSTNAME = "report.pskreporter.info";
-const     auto PSK_REPORTER_IPADDRESS = IPAddress(74,116,41,13);
-constexpr auto PSK_REPORTER_PORT = 4739;
-constexpr auto PSK_REPORTER_TEST_PORT = 14739;
-constexpr auto PSK_MAX_RECORDS = 40;   // must be less than the max datagram size;
-constexpr auto MAX_BUFFER_SIZE = 1471; // must be less than the max datagram size;
 
 // RX record:
 /* For receiver callsign, receiver locator, decoding software use */
@@ -51,52 +55,51 @@ static const uint8_t txFormatHeader[] = {
     0x80, 0x0B, 0x00, 0x01, 0x00, 0x00, 0x76, 0x8F,
     0x00, 0x96, 0x00, 0x04};
 
+// Callsign, frequency, SNR, mode, information source and flow start time
+static const size_t MAX_ENCODED_RECORD_SIZE = (1 + MAX_CALLSIGN_LENGTH) + 4 + 1 + (1 + 3) + 1 + 4;
+
+// Callsign, locator and software, with the set header and padding
+static const size_t MAX_REPORTER_RECORD_SIZE = 4 + 2 * (1 + MAX_CALLSIGN_LENGTH) + (1 + MAX_SOFTWARE_LENGTH) + 3;
+static const size_t DATAGRAM_HEADER_SIZE = 16 + sizeof(rxFormatHeader) + sizeof(txFormatHeader) + MAX_REPORTER_RECORD_SIZE;
+// The fewest records a datagram holds, each at its largest, as encodeReceivedRecords() fills it
+static const size_t MIN_RECORDS_PER_DATAGRAM = (MAX_DATAGRAM_SIZE - DATAGRAM_HEADER_SIZE - 7) / MAX_ENCODED_RECORD_SIZE;
+static const size_t MAX_DATAGRAMS_PER_STORE = (PSK_MAX_RECORDS + MIN_RECORDS_PER_DATAGRAM - 1) / MIN_RECORDS_PER_DATAGRAM;
+
+// A flush of every receiver with a full store is one batch, and a batch
+// cannot reclaim its own buffers
+static_assert(DATAGRAM_POOL_SIZE >= MAX_RECEIVERS * MAX_DATAGRAMS_PER_STORE,
+              "DATAGRAM_POOL_SIZE is too small for MAX_RECEIVERS full record stores");
+
 // Helper to write a length-prefixed string to a buffer
-static uint8_t *writeLengthPrefixedString(uint8_t *buf, const SafeString &str)
+static uint8_t *writeLengthPrefixedString(uint8_t *buf, const char *str, size_t length)
 {
-    size_t length = str.length();
     *buf++ = (uint8_t)length;
-    memcpy(buf, str.c_str(), length);
+    memcpy(buf, str, length);
     return buf + length;
 }
 
-// Helper to read a length-prefixed string from a buffer
-static const uint8_t *readLengthPrefixedString(const uint8_t *buf, SafeString &str)
+// The callsign is only turned back into text here
+size_t ReceivedRecord::encode(uint8_t *bufIn, ReportStatistic statistic, const RecordStore &store) const
 {
-    uint8_t length = *buf++;
-    // Create a SafeString from a non-null-terminated buffer and length
-    str = SafeString(reinterpret_cast<const char *>(buf), length);
-    return buf + length;
-}
+    uint32_t frequency;
+    int8_t snr;
+    uint32_t flowTimeSeconds;
+    select(statistic, frequency, snr, flowTimeSeconds);
 
-ReceivedRecord::ReceivedRecord() : frequency(0), snr(0), infoSource(0), flowTimeSeconds(0)
-{
-}
-
-ReceivedRecord::ReceivedRecord(const SafeString &callsign, uint32_t frequency, uint8_t snr)
-    : callsign(callsign),
-      frequency(frequency),
-      snr(snr),
-      mode("FT8"),
-      infoSource(1),
-      flowTimeSeconds((uint32_t)time(0))
-{
-}
-
-size_t ReceivedRecord::encode(uint8_t *bufIn) const
-{
-    // Callsign
-    uint8_t *buf = writeLengthPrefixedString(bufIn, callsign);
+    // Callsign, written straight after its length
+    uint8_t *buf = bufIn + 1;
+    *bufIn = (uint8_t)store.callsignText(callsign, (char *)buf);
+    buf += *bufIn;
 
     // Frequency (network byte order)
     *((uint32_t *)buf) = htonl(frequency);
     buf += sizeof(uint32_t);
 
     // SNR
-    *buf++ = snr;
+    *buf++ = (uint8_t)snr;
 
     // Mode
-    buf = writeLengthPrefixedString(buf, mode);
+    buf = writeLengthPrefixedString(buf, "FT8", 3);
 
     // Info source
     *buf++ = infoSource;
@@ -107,132 +110,210 @@ size_t ReceivedRecord::encode(uint8_t *bufIn) const
     return buf - bufIn;
 }
 
-PskReporter::PskReporter(uint32_t randomIdentifierIn, bool testModeIn) : currentSequenceNumber(0),
-                                                                         testMode(testModeIn),
-                                                                         randomIdentifier(randomIdentifierIn)
+PskReporter::PskReporter(uint32_t randomIdentifierIn) : currentSequenceNumber(0),
+                                                        randomIdentifier(randomIdentifierIn),
+                                                        reportStatistic(REPORT_BEST_SNR),
+                                                        spotHistory(NULL),
+                                                        bandStats(NULL),
+                                                        ingressFilter(NULL),
+                                                        filterReceiver(0)
+{
+    memset(&reporterStats, 0, sizeof(reporterStats));
+}
+
+void PskReporter::setRandomIdentifier(uint32_t identifier)
+{
+    randomIdentifier = identifier;
+}
+
+void PskReporter::setBandStats(BandStats *stats)
+{
+    bandStats = stats;
+}
+
+// Stations are added as their records start and cleared when they are
+// sent, so the filter holds what is waiting in this store
+void PskReporter::setIngressFilter(IngressFilter *filter, uint8_t receiver)
+{
+    ingressFilter = filter;
+    filterReceiver = receiver;
+}
+
+void PskReporter::setSpotHistory(SpotHistory *history)
+{
+    spotHistory = history;
+}
+
+// Keeps what was reported for later queries
+void PskReporter::recordHistory() const
+{
+    if (spotHistory == NULL)
+        return;
+
+    for (auto &rec : records)
+    {
+        uint32_t frequency;
+        int8_t snr;
+        uint32_t time;
+        rec.select(reportStatistic, frequency, snr, time);
+        char text[MAX_CALLSIGN_LENGTH + 1];
+        StringView callsign = {text, (uint8_t)records.callsignText(rec.callsign, text)};
+        spotHistory->add(callsign, frequency, snr, time);
+    }
+}
+
+void PskReporter::setReportStatistic(ReportStatistic statistic)
 {
+    reportStatistic = statistic;
 }
 
-bool PskReporter::createSenderRecord(const uint8_t *encodedBuf)
+bool PskReporter::createSenderRecord(const uint8_t *encodedBuf, size_t length)
 {
-    if (!encodedBuf)
+    SenderRecordView record;
+    if (!decodeSenderRecord(encodedBuf, length, record))
         return false;
 
-    encodedBuf = readLengthPrefixedString(encodedBuf, reporterCallsign);
-    encodedBuf = readLengthPrefixedString(encodedBuf, reporterGridSquare);
+    reporterCallsign.assign(record.callsign);
+    reporterGridSquare.assign(record.gridSquare);
 
     return true;
 }
 
-bool PskReporter::createSenderSoftwareRecord(const uint8_t *encodedBuf)
+bool PskReporter::createSenderSoftwareRecord(const uint8_t *encodedBuf, size_t length)
 {
-    if (!encodedBuf)
+    SenderSoftwareRecordView record;
+    if (!decodeSenderSoftwareRecord(encodedBuf, length, record))
         return false;
 
-    encodedBuf = readLengthPrefixedString(encodedBuf, decodingSoftware);
+    decodingSoftware.assign(record.software);
 
     return true;
 }
 
 PskReporter::~PskReporter()
 {
-    recordList.clear();
+    records.clear();
 }
 
-bool PskReporter::alreadyLogged(const SafeString &callsign) const
+bool PskReporter::addReceivedRecord(const uint8_t *encodedBuf, size_t length)
 {
-    bool result = false;
-    for (auto &item : recordList)
-    {
-        if (item.callsign == callsign)
-        {
-            result = true;
-            break;
-        }
-    }
-    return result;
+    ReceivedRecordView record;
+    if (!decodeReceivedRecord(encodedBuf, length, record))
+        return false;
+
+    return addReceivedRecord(record);
 }
 
-bool PskReporter::addReceivedRecord(const uint8_t *encodedBuf)
+bool PskReporter::addPackedReceivedRecord(const uint8_t *encodedBuf, size_t length)
 {
-    if (!encodedBuf)
+    ReceivedRecordView record;
+    if (!decodePackedReceivedRecord(encodedBuf, length, record))
         return false;
 
-    SafeString callsign;
-    encodedBuf = readLengthPrefixedString(encodedBuf, callsign);
+    return addReceivedRecord(record);
+}
 
-    uint32_t frequency = *(const uint32_t *)encodedBuf;
-    encodedBuf += sizeof(uint32_t);
+// Repeat decodes update the station's aggregate in place. Standard
+// callsigns, packed or as text, are stored and matched as their packed
+// value; only those that do not pack keep their text.
+bool PskReporter::addReceivedRecord(const ReceivedRecordView &record)
+{
+    uint32_t now = (uint32_t)time(0);
+    uint32_t callsign = 0;
+    bool keyed = records.callsignKey(record, callsign);
+    uint32_t station = RecordStore::stationKey(record);
+    // every decode counts, even a repeat or one the store has no room for
+    if (bandStats != NULL)
+        bandStats->add(station, record.frequency, (int8_t)record.snr, now);
+    if (!keyed)
+    {
+        ++reporterStats.textTableFull;
+        return false;
+    }
 
-    uint8_t snr = *encodedBuf++;
+    bool inserted = false;
+    ReceivedRecord *received = records.findOrInsert(callsign, inserted);
+    if (received == NULL)
+    {
+        ++reporterStats.storeFull;
+        return false;
+    }
+    ++reporterStats.accepted;
 
-    if (recordList.size() < PSK_MAX_RECORDS && !alreadyLogged(callsign))
+    if (inserted)
     {
-        recordList.push_back(ReceivedRecord(callsign, frequency, snr));
-        return true;
+        received->initialise(callsign, record, now);
+        if (ingressFilter != NULL)
+            ingressFilter->addStation(filterReceiver, station);
     }
-    return false;
+    else
+        received->update(record, now);
+    return true;
 }
 
+// Encodes the pending records once and hands the datagrams to every sink,
+// which send them in their own time. A store larger than one datagram is
+// split across as many as it needs, as a batch so none of them is reclaimed
+// for a later one.
 bool PskReporter::send()
 {
-    size_t written = 0;
-    if (recordList.size() > 0 && WiFi.status() == WL_CONNECTED && WiFi.getMode() == WIFI_STA)
+    if (records.empty())
+        return false;
+
+    bool sent = false;
+    beginDatagramBatch();
+    const ReceivedRecord *next = records.begin();
+    while (next != records.end())
     {
-        WiFiUDP wifiUdp;
-
-        SafeString packet(MAX_BUFFER_SIZE);
-        if (packet.c_str() == NULL)
-            return false; // Memory allocation failed
-
-        // Encode packet header and fields
-        uint8_t *ptrStart = (uint8_t *)packet.get();
-        uint8_t *p = ptrStart;
-        *p++ = 0x00;
-        *p++ = 0x0A;
-        p += sizeof(uint16_t);
-        *((uint32_t *)p) = htonl((uint32_t)time(0));
-        p += sizeof(uint32_t);
-        *((uint32_t *)p) = htonl(currentSequenceNumber++);
-        p += sizeof(uint32_t);
-        *((uint32_t *)p) = htonl(randomIdentifier);
-        p += sizeof(uint32_t);
-
-        memcpy(p, rxFormatHeader, sizeof(rxFormatHeader));
-        p += sizeof(rxFormatHeader);
-
-        if (!recordList.empty())
+        DatagramHandle datagram;
+        if (!acquireDatagram(datagram))
         {
-            memcpy(p, txFormatHeader, sizeof(txFormatHeader));
-            p += sizeof(txFormatHeader);
+            Serial.printf("PskReporter::send(): no datagram buffer, %u records dropped\n",
+                          (unsigned)(records.end() - next));
+            break;
         }
+        size_t size = encodeDatagram(datagram.data, next);
+        publishDatagram(datagram, size);
+        sent = true;
+    }
+    endDatagramBatch();
 
-        size_t size = encodeReporterRecord(p);
-        p += size;
-        size = encodeReceivedRecords(p);
-        p += size;
-        recordList.clear();
+    recordHistory();
+    records.clear();
+    if (ingressFilter != NULL)
+        ingressFilter->clear(filterReceiver);
+    return sent;
+}
 
-        const int port = testMode ? PSK_REPORTER_TEST_PORT : PSK_REPORTER_PORT;
-        if (wifiUdp.beginPacket(PSK_REPORTER_HOSTNAME, port) == 0)
-        {
-            Serial.println("Failed to connect to PSKReporter server by hostname");
-            if (wifiUdp.beginPacket(PSK_REPORTER_IPADDRESS, port) == 0)
-            {
-                Serial.println("Failed to connect to PSKReporter server by IP address");
-                return false;
-            }
-        }
- 
-        size = p - ptrStart;
-        p = ptrStart + 2;
-        *((uint16_t *)p) = htons((uint16_t)size);
-
-        written = wifiUdp.write((const uint8_t *)packet.c_str(), size);
-        wifiUdp.endPacket();
-        wifiUdp.stop();
-    }
-    return written > 0;
+size_t PskReporter::encodeDatagram(uint8_t *ptrStart, const ReceivedRecord *&next)
+{
+    // Encode packet header and fields
+    uint8_t *p = ptrStart;
+    *p++ = 0x00;
+    *p++ = 0x0A;
+    p += sizeof(uint16_t);
+    *((uint32_t *)p) = htonl((uint32_t)time(0));
+    p += sizeof(uint32_t);
+    *((uint32_t *)p) = htonl(currentSequenceNumber++);
+    p += sizeof(uint32_t);
+    *((uint32_t *)p) = htonl(randomIdentifier);
+    p += sizeof(uint32_t);
+
+    memcpy(p, rxFormatHeader, sizeof(rxFormatHeader));
+    p += sizeof(rxFormatHeader);
+
+    memcpy(p, txFormatHeader, sizeof(txFormatHeader));
+    p += sizeof(txFormatHeader);
+
+    size_t size = encodeReporterRecord(p);
+    p += size;
+    size = encodeReceivedRecords(p, MAX_DATAGRAM_SIZE - (p - ptrStart), next);
+    p += size;
+
+    size = p - ptrStart;
+    p = ptrStart + 2;
+    *((uint16_t *)p) = htons((uint16_t)size);
+    return size;
 }
 
 inline static size_t pad4(size_t size)
@@ -240,6 +321,16 @@ inline static size_t pad4(size_t size)
     return (size + 3) & 0xfffffffcU;
 }
 
+// Pads a set to a multiple of four bytes with zeros, the datagram buffers
+// are reused so the padding would otherwise be left over from the last one
+static size_t padSet(uint8_t *bufStart, uint8_t *buf)
+{
+    size_t size = buf - bufStart;
+    size_t padded = pad4(size);
+    memset(buf, 0, padded - size);
+    return padded;
+}
+
 size_t PskReporter::encodeReporterRecord(uint8_t *bufStart) const
 {
     uint8_t *buf = bufStart;
@@ -248,22 +339,23 @@ size_t PskReporter::encodeReporterRecord(uint8_t *bufStart) const
     // room for the size
     buf += sizeof(uint16_t);
 
-    buf = writeLengthPrefixedString(buf, reporterCallsign);
-    buf = writeLengthPrefixedString(buf, reporterGridSquare);
-    buf = writeLengthPrefixedString(buf, decodingSoftware);
+    buf = writeLengthPrefixedString(buf, reporterCallsign.data, reporterCallsign.length);
+    buf = writeLengthPrefixedString(buf, reporterGridSquare.data, reporterGridSquare.length);
+    buf = writeLengthPrefixedString(buf, decodingSoftware.data, decodingSoftware.length);
 
-    size_t size = buf - bufStart;
-    size = pad4(size);
+    size_t size = padSet(bufStart, buf);
 
     buf = bufStart + 2;
     *((uint16_t *)buf) = htons((uint16_t)size);
     return size;
 }
 
-size_t PskReporter::encodeReceivedRecords(uint8_t *bufStart)
+// Encodes records from next onwards while they fit in space, leaving next
+// at the first record that did not
+size_t PskReporter::encodeReceivedRecords(uint8_t *bufStart, size_t space, const ReceivedRecord *&next)
 {
     uint8_t *buf = bufStart;
-    if (recordList.empty())
+    if (next == records.end())
         return 0;
 
     *buf++ = 0x99;
@@ -271,16 +363,14 @@ size_t PskReporter::encodeReceivedRecords(uint8_t *bufStart)
     // room for the size
     buf += sizeof(uint16_t);
 
-    size_t size = 4;
-
-    for (auto &rec : recordList)
+    // the set header plus padding takes up to 7 bytes
+    while (next != records.end() && (size_t)(buf - bufStart) + MAX_ENCODED_RECORD_SIZE + 3 <= space)
     {
-        size_t bufSize = rec.encode(buf);
-        size += bufSize;
-        buf += bufSize;
+        buf += next->encode(buf, reportStatistic, records);
+        ++next;
     }
 
-    size = pad4(size);
+    size_t size = padSet(bufStart, buf);
 
     buf = bufStart + 2;
     *((uint16_t *)buf) = htons((uint16_t)size);
@@ -0,0 +1,161 @@
+/* Copyright (c) 2025 Paul Winwood, G8KIG - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the GPL-Version 3 license.
+ *
+ * There is a copy of the GPL-Version 3 license in the same folder as this file.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "PackedCallsign.h"
+
+// Characters allowed in each of the six positions; a callsign whose digit
+// is second is shifted right by one, so the digit is always third
+static const char prefixAlphabet[] = " 0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+static const char secondAlphabet[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+static const char suffixAlphabet[] = " ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+
+static bool isDigit(char ch)
+{
+    return ch >= '0' && ch <= '9';
+}
+
+static bool isLetter(char ch)
+{
+    return ch >= 'A' && ch <= 'Z';
+}
+
+static int prefixIndex(char ch)
+{
+    if (ch == ' ')
+        return 0;
+    if (isDigit(ch))
+        return ch - '0' + 1;
+    return isLetter(ch) ? ch - 'A' + 11 : -1;
+}
+
+static int secondIndex(char ch)
+{
+    if (isDigit(ch))
+        return ch - '0';
+    return isLetter(ch) ? ch - 'A' + 10 : -1;
+}
+
+static int suffixIndex(char ch)
+{
+    if (ch == ' ')
+        return 0;
+    return isLetter(ch) ? ch - 'A' + 1 : -1;
+}
+
+bool packCallsign(const char *text, size_t length, uint32_t &packed)
+{
+    uint32_t suffix = SUFFIX_NONE;
+    if (length > 2 && text[length - 2] == '/')
+    {
+        if (text[length - 1] == 'R')
+            suffix = SUFFIX_R;
+        else if (text[length - 1] == 'P')
+            suffix = SUFFIX_P;
+        else
+            return false;
+        length -= 2;
+    }
+
+    // Swaziland's 3DA0 and Guinea's 3X prefixes are sent as 3D0 and Q
+    char c6[6] = {' ', ' ', ' ', ' ', ' ', ' '};
+    if (length > 4 && length <= 7 && memcmp(text, "3DA0", 4) == 0)
+    {
+        memcpy(c6, "3D0", 3);
+        memcpy(c6 + 3, text + 4, length - 4);
+    }
+    else if (length > 2 && length <= 7 && text[0] == '3' && text[1] == 'X' && isLetter(text[2]))
+    {
+        c6[0] = 'Q';
+        memcpy(c6 + 1, text + 2, length - 2);
+    }
+    else if (length > 2 && length <= 6 && isDigit(text[2]))
+    {
+        memcpy(c6, text, length);
+    }
+    else if (length > 1 && length <= 5 && isDigit(text[1]))
+    {
+        memcpy(c6 + 1, text, length);
+    }
+    else
+    {
+        return false;
+    }
+
+    int i0 = prefixIndex(c6[0]);
+    int i1 = secondIndex(c6[1]);
+    int i3 = suffixIndex(c6[3]);
+    int i4 = suffixIndex(c6[4]);
+    int i5 = suffixIndex(c6[5]);
+    if (i0 < 0 || i1 < 0 || !isDigit(c6[2]) || i3 < 0 || i4 < 0 || i5 < 0)
+        return false;
+    // the letters after the digit cannot have a gap
+    if ((i3 == 0 && i4 != 0) || (i4 == 0 && i5 != 0))
+        return false;
+
+    uint32_t n = (uint32_t)i0;
+    n = n * 36 + i1;
+    n = n * 10 + (c6[2] - '0');
+    n = n * 27 + i3;
+    n = n * 27 + i4;
+    n = n * 27 + i5;
+    packed = (C28_STANDARD + n) | (suffix << CALLSIGN_SUFFIX_SHIFT);
+    return true;
+}
+
+size_t unpackCallsign(uint32_t packed, char *text)
+{
+    if (!isStandardCallsign(packed))
+        return 0;
+
+    uint32_t n = (packed & C28_MASK) - C28_STANDARD;
+    char c6[6];
+    c6[5] = suffixAlphabet[n % 27];
+    n /= 27;
+    c6[4] = suffixAlphabet[n % 27];
+    n /= 27;
+    c6[3] = suffixAlphabet[n % 27];
+    n /= 27;
+    c6[2] = '0' + n % 10;
+    n /= 10;
+    c6[1] = secondAlphabet[n % 36];
+    n /= 36;
+    c6[0] = prefixAlphabet[n % 37];
+
+    size_t first = c6[0] == ' ' ? 1 : 0;
+    size_t last = 6;
+    while (last > 3 && c6[last - 1] == ' ')
+        --last;
+
+    size_t length = 0;
+    if (first == 0 && memcmp(c6, "3D0", 3) == 0 && last > 3)
+    {
+        memcpy(text, "3DA0", 4);
+        length = 4;
+        first = 3;
+    }
+    else if (c6[0] == 'Q' && isLetter(c6[1]))
+    {
+        memcpy(text, "3X", 2);
+        length = 2;
+        first = 1;
+    }
+    memcpy(text + length, c6 + first, last - first);
+    length += last - first;
+
+    uint32_t suffix = packed >> CALLSIGN_SUFFIX_SHIFT;
+    if (suffix != SUFFIX_NONE)
+    {
+        text[length++] = '/';
+        text[length++] = suffix == SUFFIX_R ? 'R' : 'P';
+    }
+    text[length] = 0;
+    return length;
+}
@@ -0,0 +1,218 @@
+/* Copyright (c) 2025 Paul Winwood, G8KIG - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the GPL-Version 3 license.
+ *
+ * There is a copy of the GPL-Version 3 license in the same folder as this file.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "FrameDecoder.h"
+#include "PackedCallsign.h"
+#include "RecordStore.h"
+
+constexpr size_t RecordStore::INDEX_SIZE;
+constexpr size_t RecordStore::NONSTANDARD_INDEX_SIZE;
+
+void ReceivedRecord::initialise(uint32_t callsignIn, const ReceivedRecordView &record, uint32_t now)
+{
+    callsign = callsignIn;
+    firstSnr = bestSnr = latestSnr = (int8_t)record.snr;
+    infoSource = 1;
+    decodes = 1;
+    firstFrequency = latestFrequency = record.frequency;
+    firstSeen = lastSeen = now;
+}
+
+void ReceivedRecord::update(const ReceivedRecordView &record, uint32_t now)
+{
+    int8_t snr = (int8_t)record.snr;
+    if (snr > bestSnr)
+        bestSnr = snr;
+    latestSnr = snr;
+    latestFrequency = record.frequency;
+    lastSeen = now;
+    if (decodes < UINT16_MAX)
+        decodes++;
+}
+
+void ReceivedRecord::select(ReportStatistic statistic, uint32_t &frequency, int8_t &snr, uint32_t &time) const
+{
+    switch (statistic)
+    {
+    case REPORT_LATEST:
+        frequency = latestFrequency;
+        snr = latestSnr;
+        time = lastSeen;
+        break;
+    case REPORT_FIRST:
+        frequency = firstFrequency;
+        snr = firstSnr;
+        time = firstSeen;
+        break;
+    case REPORT_BEST_SNR:
+    default:
+        frequency = latestFrequency;
+        snr = bestSnr;
+        time = firstSeen;
+        break;
+    }
+}
+
+RecordStore::RecordStore()
+{
+    clear();
+}
+
+void RecordStore::clear()
+{
+    count = 0;
+    nonstandardCount = 0;
+    for (size_t idx = 0; idx < INDEX_SIZE; ++idx)
+        index[idx] = EMPTY_SLOT;
+    for (size_t idx = 0; idx < NONSTANDARD_INDEX_SIZE; ++idx)
+        nonstandardIndex[idx] = EMPTY_SLOT;
+}
+
+size_t RecordStore::size() const
+{
+    return count;
+}
+
+bool RecordStore::empty() const
+{
+    return count == 0;
+}
+
+size_t RecordStore::capacity() const
+{
+    return PSK_MAX_RECORDS;
+}
+
+const ReceivedRecord *RecordStore::begin() const
+{
+    return records;
+}
+
+const ReceivedRecord *RecordStore::end() const
+{
+    return records + count;
+}
+
+// FNV-1a
+uint32_t RecordStore::hash(const StringView &callsign)
+{
+    uint32_t hash = 2166136261U;
+    for (uint8_t idx = 0; idx < callsign.length; ++idx)
+    {
+        hash ^= (uint8_t)callsign.data[idx];
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+// Index slot holding the text of a callsign that does not pack, or the
+// empty slot where it would go, found by its FNV-1a hash
+size_t RecordStore::probeText(const StringView &callsign, uint32_t hash) const
+{
+    size_t slot = hash & (NONSTANDARD_INDEX_SIZE - 1);
+    while (nonstandardIndex[slot] != EMPTY_SLOT)
+    {
+        const NonstandardCallsign &entry = nonstandard[nonstandardIndex[slot]];
+        if (entry.hash == hash && callsign.equals(entry.text, entry.length))
+            break;
+        slot = (slot + 1) & (NONSTANDARD_INDEX_SIZE - 1);
+    }
+    return slot;
+}
+
+// A standard callsign, whether it came packed or as text
+bool RecordStore::packedKey(const ReceivedRecordView &record, uint32_t &key)
+{
+    if (isStandardCallsign(record.packed))
+    {
+        key = record.packed;
+        return true;
+    }
+    return packCallsign(record.callsign.data, record.callsign.length, key);
+}
+
+uint32_t RecordStore::stationKey(const ReceivedRecordView &record)
+{
+    uint32_t key;
+    return packedKey(record, key) ? key : hash(record.callsign);
+}
+
+// Callsigns that do not pack keep their text in a table of their own,
+// indexed like the records. Their keys fall in the range of FT8's hashes,
+// which are never stored.
+bool RecordStore::callsignKey(const ReceivedRecordView &record, uint32_t &key)
+{
+    if (packedKey(record, key))
+        return true;
+    if (record.callsign.length == 0)
+        return false;
+
+    uint32_t textHash = hash(record.callsign);
+    size_t slot = probeText(record.callsign, textHash);
+    if (nonstandardIndex[slot] != EMPTY_SLOT)
+    {
+        key = C28_TOKENS + nonstandardIndex[slot];
+        return true;
+    }
+    if (nonstandardCount >= NONSTANDARD_CALLSIGNS)
+        return false;
+
+    NonstandardCallsign &entry = nonstandard[nonstandardCount];
+    entry.hash = textHash;
+    memcpy(entry.text, record.callsign.data, record.callsign.length);
+    entry.length = record.callsign.length;
+    nonstandardIndex[slot] = (int16_t)nonstandardCount;
+    key = C28_TOKENS + nonstandardCount++;
+    return true;
+}
+
+size_t RecordStore::callsignText(uint32_t callsign, char *text) const
+{
+    if (isStandardCallsign(callsign))
+        return unpackCallsign(callsign, text);
+
+    const NonstandardCallsign &entry = nonstandard[callsign - C28_TOKENS];
+    memcpy(text, entry.text, entry.length);
+    text[entry.length] = 0;
+    return entry.length;
+}
+
+// Index slot holding the callsign, or the empty slot where it would go.
+// Consecutive callsigns pack to nearby values, so the key is scrambled by
+// a Fibonacci hash first. The index is never more than half full so the
+// probe always terminates.
+size_t RecordStore::probe(uint32_t callsign) const
+{
+    size_t slot = ((callsign * 2654435761U) >> 16) & (INDEX_SIZE - 1);
+    while (index[slot] != EMPTY_SLOT && records[index[slot]].callsign != callsign)
+        slot = (slot + 1) & (INDEX_SIZE - 1);
+    return slot;
+}
+
+const ReceivedRecord *RecordStore::find(uint32_t callsign) const
+{
+    size_t slot = probe(callsign);
+    return index[slot] == EMPTY_SLOT ? NULL : records + index[slot];
+}
+
+ReceivedRecord *RecordStore::findOrInsert(uint32_t callsign, bool &inserted)
+{
+    inserted = false;
+    size_t slot = probe(callsign);
+    if (index[slot] != EMPTY_SLOT)
+        return records + index[slot];
+
+    if (count >= PSK_MAX_RECORDS)
+        return NULL;
+
+    index[slot] = (int16_t)count;
+    inserted = true;
+    return records + count++;
+}
@@ -0,0 +1,91 @@
+/* Copyright (c) 2025 Paul Winwood, G8KIG - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the GPL-Version 3 license.
+ *
+ * There is a copy of the GPL-Version 3 license in the same folder as this file.
+ */
+
+#include <Arduino.h>
+#include <WiFi.h>
+
+#include "crc.h"
+#include "LatencyHistogram.h"
+#include "workqueue.h"
+#include "FrameDecoder.h"
+#include "RecordStore.h"
+#include "Bands.h"
+#include "SpotHistory.h"
+#include "BandStats.h"
+#include "IngressFilter.h"
+#include "SpotSink.h"
+#include "PSKReporter.h"
+#include "ReporterSet.h"
+
+ReporterSet::ReporterSet()
+{
+}
+
+// PSK Reporter tells streams apart by the observation domain, so every
+// receiver needs its own identifier
+static uint32_t receiverIdentifier(uint32_t baseIdentifier, uint8_t receiver)
+{
+    if (receiver == 0)
+        return baseIdentifier;
+    uint8_t seed[5];
+    memcpy(seed, &baseIdentifier, sizeof(baseIdentifier));
+    seed[4] = receiver;
+    return crc32(seed, sizeof(seed));
+}
+
+void ReporterSet::begin(uint32_t baseIdentifier, ReportStatistic statistic, SpotHistory *history, BandStats *stats,
+                        IngressFilter *filter)
+{
+    for (uint8_t receiver = 0; receiver < MAX_RECEIVERS; ++receiver)
+    {
+        reporters[receiver].setRandomIdentifier(receiverIdentifier(baseIdentifier, receiver));
+        reporters[receiver].setReportStatistic(statistic);
+        reporters[receiver].setSpotHistory(history);
+        reporters[receiver].setBandStats(stats);
+        reporters[receiver].setIngressFilter(filter, receiver);
+    }
+}
+
+PskReporter *ReporterSet::get(uint8_t receiver)
+{
+    return receiver < MAX_RECEIVERS ? reporters + receiver : NULL;
+}
+
+bool ReporterSet::sendAll()
+{
+    bool sent = false;
+    beginDatagramBatch();
+    for (uint8_t receiver = 0; receiver < MAX_RECEIVERS; ++receiver)
+    {
+        if (reporters[receiver].pendingRecords() > 0)
+            sent |= reporters[receiver].send();
+    }
+    endDatagramBatch();
+    return sent;
+}
+
+size_t ReporterSet::pendingRecords() const
+{
+    size_t pending = 0;
+    for (uint8_t receiver = 0; receiver < MAX_RECEIVERS; ++receiver)
+        pending += reporters[receiver].pendingRecords();
+    return pending;
+}
+
+void ReporterSet::printStats() const
+{
+    ReporterStats total = {0, 0, 0};
+    for (uint8_t receiver = 0; receiver < MAX_RECEIVERS; ++receiver)
+    {
+        const ReporterStats &stats = reporters[receiver].stats();
+        total.accepted += stats.accepted;
+        total.storeFull += stats.storeFull;
+        total.textTableFull += stats.textTableFull;
+    }
+    Serial.printf("reporters: %u spots accepted, dropped %u with the record store full, %u with no room for callsign text\n",
+                  total.accepted, total.storeFull, total.textTableFull);
+}
@@ -11,18 +11,26 @@
 
 #include "SafeString.h"
 
+static const size_t MIN_CAPACITY = 15;        // smallest buffer a builder grows to
+static const size_t FORMAT_STACK_SIZE = 128;  // most formatted lines fit here
+
 char SafeString::EmptyChar = 0;
 
 SafeString::StringData::StringData()
-    : data(NULL), length(0), refCount(1)
+    : data(NULL), length(0), capacity(0), refCount(1)
 {
 }
 
 SafeString::StringData::StringData(const char *s, size_t len)
-    : length(len), refCount(1)
+    : StringData(s, len, len)
+{
+}
+
+SafeString::StringData::StringData(const char *s, size_t len, size_t capacityIn)
+    : length(len), capacity(capacityIn > len ? capacityIn : len), refCount(1)
 {
     // note: assumes that new does not throw an exception
-    data = new char[length + 1];
+    data = new char[capacity + 1];
     if (data != NULL)
     {
         if (s != NULL)
@@ -35,6 +43,11 @@ SafeString::StringData::StringData(const char *s, size_t len)
             memset(data, 0, length + 1);
         }
     }
+    else
+    {
+        length = 0;
+        capacity = 0;
+    }
 }
 
 SafeString::StringData::~StringData()
@@ -122,7 +135,7 @@ void SafeString::detach()
     if (pData->refCount > 1)
     {
         // note: assumes that new does not throw an exception
-        StringData *newData = new StringData(pData->data, pData->length);
+        StringData *newData = new StringData(pData->data, pData->length, pData->capacity);
         --pData->refCount;
         pData = newData;
     }
@@ -170,38 +183,197 @@ int SafeString::getRefCount() const
     return pData->refCount;
 }
 
-bool SafeString::Format(const char *fmt, ...)
+size_t SafeString::capacity() const
 {
-    // Estimate required buffer size
-    va_list args, args_size;
-    va_start(args, fmt);
-    va_copy(args_size, args);
-    int size = vsnprintf(nullptr, 0, fmt, args_size);
-    va_end(args_size);
+    return pData->capacity;
+}
 
-    if (size < 0)
+// Move to a buffer of its own holding capacity characters
+bool SafeString::reallocate(size_t capacity)
+{
+    // note: assumes that new does not throw an exception
+    StringData *newData = new StringData(pData->data, pData->length, capacity);
+    if (newData->data == NULL)
     {
-        va_end(args);
+        delete newData;
         return false;
     }
+    if (--pData->refCount == 0)
+    {
+        delete pData;
+    }
+    pData = newData;
+    return true;
+}
+
+// Doubling, so a string built up by appends is reallocated a handful of
+// times
+static size_t grownCapacity(size_t capacity, size_t required)
+{
+    if (required <= capacity)
+    {
+        return capacity;
+    }
+    capacity *= 2;
+    if (capacity < required)
+    {
+        capacity = required;
+    }
+    if (capacity < MIN_CAPACITY)
+    {
+        capacity = MIN_CAPACITY;
+    }
+    return capacity;
+}
+
+// Make room for required characters in a buffer that is not shared,
+// doubling the capacity when it has to grow
+bool SafeString::grow(size_t required)
+{
+    if (required <= pData->capacity)
+    {
+        if (pData->refCount == 1 && pData->data != NULL)
+        {
+            return true;
+        }
+        return reallocate(pData->capacity);
+    }
 
-    detach(); // Ensure unique copy before modifying
+    return reallocate(grownCapacity(pData->capacity, required));
+}
 
-    if (pData->length >= (size_t)size)
+bool SafeString::reserve(size_t capacity)
+{
+    if (capacity < pData->capacity)
     {
-        vsnprintf(pData->data, size + 1, fmt, args);
+        capacity = pData->capacity;
     }
-    else
+    if (capacity == pData->capacity && pData->refCount == 1 && pData->data != NULL)
     {
-        // Allocate buffer (+1 for null terminator)
-        SafeString temp(size);
-        vsnprintf(temp.pData->data, size + 1, fmt, args);
-        *this = temp;
+        return true;
     }
-    va_end(args);
+    return reallocate(capacity);
+}
+
+bool SafeString::append(const char *s)
+{
+    return s == NULL || append(s, strlen(s));
+}
+
+bool SafeString::append(const char *s, size_t len)
+{
+    if (s == NULL || len == 0)
+    {
+        return true;
+    }
+
+    // appending part of itself, which may move when the buffer grows
+    size_t offset = 0;
+    bool inside = pData->data != NULL && s >= pData->data && s <= pData->data + pData->length;
+    if (inside)
+    {
+        offset = s - pData->data;
+    }
+
+    if (!grow(pData->length + len))
+    {
+        return false;
+    }
+    if (inside)
+    {
+        s = pData->data + offset;
+    }
+    memmove(pData->data + pData->length, s, len);
+    pData->length += len;
+    pData->data[pData->length] = 0;
     return true;
 }
 
+void SafeString::clear()
+{
+    if (pData->refCount > 1)
+    {
+        --pData->refCount;
+        pData = new StringData();
+    }
+    else if (pData->data != NULL)
+    {
+        pData->length = 0;
+        pData->data[0] = 0;
+    }
+}
+
+// Format into the buffer at offset. An argument may point into this
+// string, as in s.appendFormat("%s", s.c_str()), so the buffer is never
+// written while vsnprintf reads the arguments: the result goes into a stack
+// buffer and is copied across, and one too long for that is formatted
+// into a new buffer before the old one is released.
+bool SafeString::formatAt(size_t offset, const char *fmt, va_list args)
+{
+    char stackBuffer[FORMAT_STACK_SIZE];
+    va_list retry;
+    va_copy(retry, args);
+    int size = vsnprintf(stackBuffer, sizeof(stackBuffer), fmt, args);
+    bool result = size >= 0;
+    if (result && (size_t)size < sizeof(stackBuffer))
+    {
+        result = grow(offset + size);
+        if (result)
+        {
+            memcpy(pData->data + offset, stackBuffer, size + 1);
+        }
+    }
+    else if (result)
+    {
+        // note: assumes that new does not throw an exception
+        size_t capacity = grownCapacity(pData->capacity, offset + size);
+        StringData *newData = new StringData(pData->data, offset, capacity);
+        result = newData->data != NULL;
+        if (result)
+        {
+            vsnprintf(newData->data + offset, size + 1, fmt, retry);
+            if (--pData->refCount == 0)
+            {
+                delete pData;
+            }
+            pData = newData;
+        }
+        else
+        {
+            delete newData;
+        }
+    }
+    va_end(retry);
+
+    if (result)
+    {
+        pData->length = offset + size;
+    }
+    return result;
+}
+
+bool SafeString::Format(const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    bool result = formatAt(0, fmt, args);
+    va_end(args);
+    if (!result)
+    {
+        clear();
+    }
+    return result;
+}
+
+bool SafeString::appendFormat(const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    bool result = formatAt(pData->length, fmt, args);
+    va_end(args);
+    return result;
+}
+
 bool SafeString::operator==(const SafeString &other) const
 {
     return pData->length == other.pData->length &&
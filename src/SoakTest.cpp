@@ -0,0 +1,191 @@
+/* Copyright (c) 2025 Paul Winwood, G8KIG - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the GPL-Version 3 license.
+ *
+ * There is a copy of the GPL-Version 3 license in the same folder as this file.
+ */
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <esp_heap_caps.h>
+
+#include "main.h"
+#include "LatencyHistogram.h"
+#include "workqueue.h"
+#include "FrameDecoder.h"
+#include "RecordStore.h"
+#include "Bands.h"
+#include "SpotHistory.h"
+#include "BandStats.h"
+#include "IngressFilter.h"
+#include "SpotSink.h"
+#include "PSKReporter.h"
+#include "LoadGenerator.h"
+#include "SoakTest.h"
+
+static const uint32_t MINUTES_PER_DAY = 1440;
+static const uint32_t SLOTS_PER_MINUTE = 4;   // FT8
+static const uint32_t BAND_CHANGE_MINUTES = 240;
+
+static const uint8_t FIRST_BAND = bandIndex(7074000); // 40m to 10m in turn
+static const uint8_t BANDS_USED = bandIndex(28074000) - FIRST_BAND + 1;
+
+struct HeapSample
+{
+    size_t used;
+    size_t free;
+    size_t largest;
+};
+
+static void sampleHeap(HeapSample &sample)
+{
+    multi_heap_info_t info;
+    heap_caps_get_info(&info, MALLOC_CAP_8BIT);
+    sample.used = info.total_allocated_bytes;
+    sample.free = info.total_free_bytes;
+    sample.largest = info.largest_free_block;
+}
+
+static uint8_t fragmentation(const HeapSample &sample)
+{
+    return sample.free > 0 ? (uint8_t)(100 - sample.largest * 100 / sample.free) : 0;
+}
+
+// Quiet overnight, busiest at midday
+static uint32_t slotDecodes(const SoakConfig &config, uint32_t minute, uint32_t &random)
+{
+    uint32_t hour = (minute / 60) % 24;
+    uint32_t activity = 20 + 80 * (12 - (hour > 12 ? hour - 12 : 12 - hour)) / 12;
+    uint32_t decodes = config.peakDecodes * activity / 100;
+    return decodes / 2 + nextRandom(random) % (decodes / 2 + 1);
+}
+
+// Most decodes are of a core of regulars, and the population drifts from
+// day to day so new callsigns keep arriving
+static uint32_t pickStation(const SoakConfig &config, uint32_t minute, uint32_t &random)
+{
+    uint32_t u = nextRandom(random) % 1024;
+    uint32_t station = (u * u * config.stationCount) >> 20;
+    return (station + (minute / MINUTES_PER_DAY) * 97) % config.stationCount;
+}
+
+bool runSoakTest(const SoakConfig &config, SoakReport &report)
+{
+    uint16_t days = config.days < 3 ? 3 : config.days;
+    uint32_t random = config.seed != 0 ? config.seed : 1;
+    uint8_t payload[BUFFER_SIZE - 1];
+    size_t size;
+    HeapSample sample;
+
+    memset(&report, 0, sizeof(report));
+    report.baselineLargest = SIZE_MAX;
+    report.finalLargest = SIZE_MAX;
+
+    muteSinks(true);
+    sampleHeap(sample);
+    report.startUsed = sample.used;
+    unsigned long started = millis();
+
+    PskReporter *reporter = new PskReporter(config.seed);
+    SpotHistory *history = new SpotHistory();
+    history->begin(config.historyCapacity);
+    reporter->setSpotHistory(history);
+    size = encodeSenderSoftwareRecord(payload, sizeof(payload), "DX FT8 Transceiver (Soak)");
+    reporter->createSenderSoftwareRecord(payload, size);
+
+    for (uint32_t minute = 0; minute < days * MINUTES_PER_DAY; ++minute)
+    {
+        const Band &band = bands[FIRST_BAND + (minute / BAND_CHANGE_MINUTES) % BANDS_USED];
+        if (minute % BAND_CHANGE_MINUTES == 0)
+        {
+            size = encodeSenderRecord(payload, sizeof(payload), "G8KIG", "IO91iq");
+            reporter->createSenderRecord(payload, size);
+        }
+
+        for (uint32_t slot = 0; slot < SLOTS_PER_MINUTE; ++slot)
+        {
+            uint32_t decodes = slotDecodes(config, minute, random);
+            for (uint32_t decode = 0; decode < decodes; ++decode)
+            {
+                uint32_t station = pickStation(config, minute, random);
+                char callsign[16];
+                stationCallsign(station, callsign);
+                uint32_t hash = stationHash(station);
+                int snr = -20 + (int)((hash >> 12) % 26) + (int)(nextRandom(random) % 7) - 3;
+                size = encodeReceivedRecord(payload, sizeof(payload), callsign,
+                                            band.ft8Hz + 200 + hash % 2800, (uint8_t)(int8_t)snr);
+                reporter->addReceivedRecord(payload, size);
+                report.spots++;
+            }
+        }
+
+        if ((minute + 1) * 60 % config.flushSeconds == 0)
+        {
+            reporter->send();
+            report.flushes++;
+        }
+
+        if ((minute + 1) % config.sampleMinutes == 0)
+        {
+            uint32_t day = minute / MINUTES_PER_DAY;
+            sampleHeap(sample);
+            report.samples++;
+            if (sample.used > report.peakUsed)
+                report.peakUsed = sample.used;
+            if (fragmentation(sample) > report.worstFragmentation)
+                report.worstFragmentation = fragmentation(sample);
+            // the first day fills the record store and the history
+            if (day == 1)
+            {
+                if (sample.used > report.baselineUsed)
+                    report.baselineUsed = sample.used;
+                if (sample.largest < report.baselineLargest)
+                    report.baselineLargest = sample.largest;
+            }
+            if (day == days - 1u)
+            {
+                if (sample.used > report.finalUsed)
+                    report.finalUsed = sample.used;
+                if (sample.largest < report.finalLargest)
+                    report.finalLargest = sample.largest;
+            }
+            // and let the idle task run on a single core board
+            delay(1);
+        }
+
+        if ((minute + 1) % MINUTES_PER_DAY == 0)
+        {
+            Serial.printf("Soak day %u: %u spots, heap used %u, largest free block %u, fragmentation %u%%\n",
+                          (unsigned)((minute + 1) / MINUTES_PER_DAY), (unsigned)report.spots, (unsigned)sample.used,
+                          (unsigned)sample.largest, fragmentation(sample));
+        }
+    }
+
+    reporter->send();
+    delete history;
+    delete reporter;
+    muteSinks(false);
+
+    sampleHeap(sample);
+    report.endUsed = sample.used;
+    report.elapsedMs = millis() - started;
+    report.passed = report.finalUsed <= report.baselineUsed + config.driftTolerance &&
+                    report.finalLargest + config.driftTolerance >= report.baselineLargest &&
+                    report.endUsed <= report.startUsed + config.driftTolerance;
+    return report.passed;
+}
+
+void printSoakReport(const SoakConfig &config, const SoakReport &report)
+{
+    Serial.printf("Soak test: %u days, %u spots, %u flushes, %u heap samples in %u ms\n",
+                  config.days < 3 ? 3u : (unsigned)config.days, (unsigned)report.spots, (unsigned)report.flushes,
+                  (unsigned)report.samples, (unsigned)report.elapsedMs);
+    Serial.printf("  heap used %u before, peak %u, %u after\n",
+                  (unsigned)report.startUsed, (unsigned)report.peakUsed, (unsigned)report.endUsed);
+    Serial.printf("  day 2 highest use %u, smallest largest block %u\n",
+                  (unsigned)report.baselineUsed, (unsigned)report.baselineLargest);
+    Serial.printf("  last day highest use %u, smallest largest block %u\n",
+                  (unsigned)report.finalUsed, (unsigned)report.finalLargest);
+    Serial.printf("  worst fragmentation %u%%, drift tolerance %u bytes: %s\n",
+                  report.worstFragmentation, (unsigned)config.driftTolerance, report.passed ? "PASSED" : "FAILED");
+}
@@ -0,0 +1,343 @@
+/* Copyright (c) 2025 Paul Winwood, G8KIG - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the GPL-Version 3 license.
+ *
+ * There is a copy of the GPL-Version 3 license in the same folder as this file.
+ */
+
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+
+#include "FrameDecoder.h"
+#include "Bands.h"
+#include "SpotHistory.h"
+
+SpotHistory::SpotHistory()
+    : callsignIds(NULL), bandIndexes(NULL), frequencyOffsets(NULL), snrs(NULL), slots(NULL),
+      callsigns(NULL), buckets(NULL), seen(NULL), freeCallsign(NO_ENTRY), callsignCapacity(0), bucketCount(0),
+      spotCapacity(0), head(0), count(0), baseTime(0), dropped(0), psram(false)
+{
+}
+
+SpotHistory::~SpotHistory()
+{
+    release();
+}
+
+void *SpotHistory::allocate(size_t size)
+{
+    return heap_caps_malloc(size, psram ? MALLOC_CAP_SPIRAM : MALLOC_CAP_8BIT);
+}
+
+void SpotHistory::release()
+{
+    heap_caps_free(callsignIds);
+    heap_caps_free(bandIndexes);
+    heap_caps_free(frequencyOffsets);
+    heap_caps_free(snrs);
+    heap_caps_free(slots);
+    heap_caps_free(callsigns);
+    heap_caps_free(buckets);
+    heap_caps_free(seen);
+    callsignIds = NULL;
+    bandIndexes = NULL;
+    frequencyOffsets = NULL;
+    snrs = NULL;
+    slots = NULL;
+    callsigns = NULL;
+    buckets = NULL;
+    seen = NULL;
+    spotCapacity = 0;
+    callsignCapacity = 0;
+    head = 0;
+    count = 0;
+}
+
+bool SpotHistory::begin(size_t capacityIn)
+{
+    release();
+    psram = psramFound();
+
+    // one interned callsign for every four spots is plenty for a busy band
+    size_t interned = capacityIn / 4;
+    interned = interned < 64 ? 64 : interned > NO_ENTRY - 1 ? NO_ENTRY - 1 : interned;
+    callsignCapacity = (uint16_t)interned;
+    bucketCount = 16;
+    while (bucketCount < callsignCapacity / 2)
+        bucketCount *= 2;
+
+    callsignIds = (uint16_t *)allocate(capacityIn * sizeof(uint16_t));
+    bandIndexes = (uint8_t *)allocate(capacityIn * sizeof(uint8_t));
+    frequencyOffsets = (int16_t *)allocate(capacityIn * sizeof(int16_t));
+    snrs = (int8_t *)allocate(capacityIn * sizeof(int8_t));
+    slots = (uint16_t *)allocate(capacityIn * sizeof(uint16_t));
+    callsigns = (Callsign *)allocate(callsignCapacity * sizeof(Callsign));
+    buckets = (uint16_t *)allocate(bucketCount * sizeof(uint16_t));
+    seen = (uint32_t *)allocate((callsignCapacity + 31) / 32 * sizeof(uint32_t));
+    if (callsignIds == NULL || bandIndexes == NULL || frequencyOffsets == NULL || snrs == NULL ||
+        slots == NULL || callsigns == NULL || buckets == NULL || seen == NULL)
+    {
+        release();
+        return false;
+    }
+
+    spotCapacity = capacityIn;
+    for (uint16_t idx = 0; idx < bucketCount; ++idx)
+        buckets[idx] = NO_ENTRY;
+    for (uint16_t idx = 0; idx < callsignCapacity; ++idx)
+    {
+        callsigns[idx].references = 0;
+        callsigns[idx].next = idx + 1 < callsignCapacity ? idx + 1 : NO_ENTRY;
+    }
+    freeCallsign = 0;
+    return true;
+}
+
+size_t SpotHistory::size() const
+{
+    return count;
+}
+
+size_t SpotHistory::capacity() const
+{
+    return spotCapacity;
+}
+
+size_t SpotHistory::memoryUsed() const
+{
+    size_t perSpot = sizeof(uint16_t) + sizeof(uint8_t) + sizeof(int16_t) + sizeof(int8_t) + sizeof(uint16_t);
+    return spotCapacity * perSpot +
+           callsignCapacity * sizeof(Callsign) +
+           bucketCount * sizeof(uint16_t) +
+           (callsignCapacity + 31) / 32 * sizeof(uint32_t);
+}
+
+uint32_t SpotHistory::droppedSpots() const
+{
+    return dropped;
+}
+
+bool SpotHistory::inPsram() const
+{
+    return psram;
+}
+
+uint16_t SpotHistory::bucketOf(const StringView &callsign) const
+{
+    // FNV-1a
+    uint32_t hash = 2166136261U;
+    for (uint8_t idx = 0; idx < callsign.length; ++idx)
+    {
+        hash ^= (uint8_t)callsign.data[idx];
+        hash *= 16777619U;
+    }
+    return (uint16_t)(hash & (bucketCount - 1));
+}
+
+uint16_t SpotHistory::findCallsign(const StringView &callsign) const
+{
+    if (buckets == NULL)
+        return NO_ENTRY;
+
+    uint16_t id = buckets[bucketOf(callsign)];
+    while (id != NO_ENTRY && !callsign.equals(callsigns[id].text, callsigns[id].length))
+        id = callsigns[id].next;
+    return id;
+}
+
+uint16_t SpotHistory::internCallsign(const StringView &callsign)
+{
+    uint16_t id = findCallsign(callsign);
+    if (id != NO_ENTRY || freeCallsign == NO_ENTRY)
+        return id;
+
+    id = freeCallsign;
+    Callsign &entry = callsigns[id];
+    freeCallsign = entry.next;
+
+    memcpy(entry.text, callsign.data, callsign.length);
+    entry.length = callsign.length;
+    entry.references = 0;
+    uint16_t bucket = bucketOf(callsign);
+    entry.next = buckets[bucket];
+    buckets[bucket] = id;
+    return id;
+}
+
+void SpotHistory::releaseCallsign(uint16_t id)
+{
+    Callsign &entry = callsigns[id];
+    if (--entry.references > 0)
+        return;
+
+    // unlink from its hash chain and return it to the free list
+    StringView text = {entry.text, entry.length};
+    uint16_t *link = buckets + bucketOf(text);
+    while (*link != id)
+        link = &callsigns[*link].next;
+    *link = entry.next;
+    entry.next = freeCallsign;
+    freeCallsign = id;
+}
+
+// Moves the base time forward when the newest spot no longer fits in the
+// 16 bit slot column, oldest spots saturate at the new base
+void SpotHistory::rebase(uint32_t time)
+{
+    uint32_t shift = (time - baseTime) / SLOT_SECONDS - 0xC000;
+    for (size_t age = 0; age < count; ++age)
+    {
+        size_t idx = spotIndex(age);
+        slots[idx] = slots[idx] > shift ? (uint16_t)(slots[idx] - shift) : 0;
+    }
+    baseTime += shift * SLOT_SECONDS;
+}
+
+size_t SpotHistory::spotIndex(size_t age) const
+{
+    return (head + spotCapacity - 1 - age) % spotCapacity;
+}
+
+void SpotHistory::dropOldest()
+{
+    releaseCallsign(callsignIds[spotIndex(count - 1)]);
+    count--;
+}
+
+bool SpotHistory::add(const StringView &callsign, uint32_t frequency, int8_t snr, uint32_t time)
+{
+    if (spotCapacity == 0 || callsign.length > MAX_CALLSIGN_LENGTH)
+    {
+        dropped++;
+        return false;
+    }
+
+    // drop the oldest spot first, it may free a callsign entry
+    if (count == spotCapacity)
+        dropOldest();
+
+    // when every callsign entry is in use keep dropping the oldest spots
+    // until one is released
+    uint16_t id = internCallsign(callsign);
+    while (id == NO_ENTRY && count > 0)
+    {
+        dropOldest();
+        id = internCallsign(callsign);
+    }
+    if (id == NO_ENTRY)
+    {
+        dropped++;
+        return false;
+    }
+
+    if (count == 0)
+        baseTime = time - time % SLOT_SECONDS;
+    if (time < baseTime)
+        time = baseTime;
+    if ((time - baseTime) / SLOT_SECONDS > 0xFFFF)
+        rebase(time);
+
+    uint8_t band = bandIndex(frequency);
+    int32_t offset = band == BAND_UNKNOWN ? 0 : (int32_t)(frequency - bands[band].ft8Hz);
+    if (offset > INT16_MAX)
+        offset = INT16_MAX;
+    else if (offset < INT16_MIN)
+        offset = INT16_MIN;
+
+    callsigns[id].references++;
+    callsignIds[head] = id;
+    bandIndexes[head] = band;
+    frequencyOffsets[head] = (int16_t)offset;
+    snrs[head] = snr;
+    slots[head] = (uint16_t)((time - baseTime) / SLOT_SECONDS);
+    head = (head + 1) % spotCapacity;
+    count++;
+    return true;
+}
+
+void SpotHistory::readSpot(size_t idx, HistorySpot &spot) const
+{
+    const Callsign &entry = callsigns[callsignIds[idx]];
+    spot.callsign.data = entry.text;
+    spot.callsign.length = entry.length;
+    spot.time = baseTime + slots[idx] * SLOT_SECONDS;
+    spot.band = bandIndexes[idx];
+    spot.frequency = spot.band == BAND_UNKNOWN ? 0 : bands[spot.band].ft8Hz + frequencyOffsets[idx];
+    spot.snr = snrs[idx];
+}
+
+void SpotHistory::clearSeen()
+{
+    memset(seen, 0, (callsignCapacity + 31) / 32 * sizeof(uint32_t));
+}
+
+bool SpotHistory::testAndSetSeen(uint16_t id)
+{
+    uint32_t mask = 1U << (id & 31);
+    bool wasSeen = (seen[id >> 5] & mask) != 0;
+    seen[id >> 5] |= mask;
+    return wasSeen;
+}
+
+size_t SpotHistory::heard(uint8_t band, uint32_t since, HistoryVisitor visitor, void *context)
+{
+    if (count == 0)
+        return 0;
+
+    uint32_t sinceSlot = since > baseTime ? (since - baseTime) / SLOT_SECONDS : 0;
+    size_t visited = 0;
+    HistorySpot spot;
+    clearSeen();
+    for (size_t age = 0; age < count; ++age)
+    {
+        size_t idx = spotIndex(age);
+        if (slots[idx] < sinceSlot || (band != BAND_UNKNOWN && bandIndexes[idx] != band))
+            continue;
+        if (testAndSetSeen(callsignIds[idx]))
+            continue;
+        readSpot(idx, spot);
+        visitor(spot, context);
+        visited++;
+    }
+    return visited;
+}
+
+bool SpotHistory::lastSeen(const StringView &callsign, HistorySpot &spot, uint32_t &spotCount) const
+{
+    uint16_t id = findCallsign(callsign);
+    if (id == NO_ENTRY)
+        return false;
+
+    for (size_t age = 0; age < count; ++age)
+    {
+        size_t idx = spotIndex(age);
+        if (callsignIds[idx] == id)
+        {
+            readSpot(idx, spot);
+            spotCount = callsigns[id].references;
+            return true;
+        }
+    }
+    return false;
+}
+
+void SpotHistory::counts(uint32_t since, HistoryCounts &result)
+{
+    memset(&result, 0, sizeof(result));
+    if (count == 0)
+        return;
+
+    uint32_t sinceSlot = since > baseTime ? (since - baseTime) / SLOT_SECONDS : 0;
+    clearSeen();
+    for (size_t age = 0; age < count; ++age)
+    {
+        size_t idx = spotIndex(age);
+        if (slots[idx] < sinceSlot)
+            continue;
+        result.spots++;
+        if (bandIndexes[idx] != BAND_UNKNOWN)
+            result.bandSpots[bandIndexes[idx]]++;
+        if (!testAndSetSeen(callsignIds[idx]))
+            result.uniqueCallsigns++;
+    }
+}
@@ -0,0 +1,456 @@
+/* Copyright (c) 2025 Paul Winwood, G8KIG - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the GPL-Version 3 license.
+ *
+ * There is a copy of the GPL-Version 3 license in the same folder as this file.
+ */
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <unistd.h>
+
+#include "SpotSink.h"
+
+static const uint32_t RESOLVE_INTERVAL_MS = 600000; // look the host up again every 10 minutes
+static const uint8_t MAX_BACKOFF_SHIFT = 5;
+
+alignas(4) static uint8_t datagramPool[DATAGRAM_POOL_SIZE][MAX_DATAGRAM_SIZE];
+static uint8_t poolUsers[DATAGRAM_POOL_SIZE];     // sinks still holding the buffer
+static bool poolReserved[DATAGRAM_POOL_SIZE];     // being encoded
+static uint32_t poolSequence[DATAGRAM_POOL_SIZE]; // publish order, oldest is evicted first
+static uint32_t nextSequence = 0;
+static int batchDepth = 0;       // only touched by the flushing task
+static bool batchPending = false;
+static uint32_t batchSequence = 0; // first sequence published in the batch
+static bool batchStalled = false;  // gave up waiting for a buffer, do not wait again
+static bool sinksMuted = false;
+
+static SpotSink *sinks[MAX_SINKS];
+static int sinkCount = 0;
+static SemaphoreHandle_t sinkMutex;
+static SemaphoreHandle_t sinkSignal;
+static SemaphoreHandle_t poolSignal; // a buffer came free
+
+// with the lock held
+static void releaseEntry(int16_t index)
+{
+    if (poolUsers[index] > 0 && --poolUsers[index] == 0)
+        xSemaphoreGive(poolSignal);
+}
+
+SpotSink::SpotSink(const char *name, uint8_t maxAttempts, uint32_t retryIntervalMs)
+    : sinkName(name),
+      maxAttempts(maxAttempts > 0 ? maxAttempts : 1),
+      retryIntervalMs(retryIntervalMs),
+      nextAttemptMs(0),
+      head(0),
+      count(0),
+      sending(false)
+{
+    memset(queue, 0, sizeof(queue));
+    memset(&sinkStats, 0, sizeof(sinkStats));
+}
+
+SpotSink::~SpotSink()
+{
+}
+
+bool SpotSink::enqueue(int16_t index, size_t length)
+{
+    if (count >= DATAGRAM_POOL_SIZE)
+        return false;
+    QueuedDatagram &item = queue[(head + count) % DATAGRAM_POOL_SIZE];
+    item.index = index;
+    item.length = (uint16_t)length;
+    item.attempts = 0;
+    ++count;
+    ++sinkStats.queued;
+    sinkStats.depth = count;
+    return true;
+}
+
+void SpotSink::evict(int16_t index)
+{
+    int kept = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        const QueuedDatagram item = queue[(head + i) % DATAGRAM_POOL_SIZE];
+        if (item.index == index)
+        {
+            ++sinkStats.evicted;
+            releaseEntry(index);
+        }
+        else
+        {
+            queue[(head + kept++) % DATAGRAM_POOL_SIZE] = item;
+        }
+    }
+    count = kept;
+    sinkStats.depth = count;
+}
+
+bool SpotSink::service(uint32_t nowMs)
+{
+    xSemaphoreTake(sinkMutex, portMAX_DELAY);
+    if (count == 0 || (int32_t)(nowMs - nextAttemptMs) < 0)
+    {
+        xSemaphoreGive(sinkMutex);
+        return false;
+    }
+    // the buffer cannot be evicted while it is being sent
+    const QueuedDatagram item = queue[head];
+    sending = true;
+    xSemaphoreGive(sinkMutex);
+
+    unsigned long started = micros();
+    SinkResult result = transmit(datagramPool[item.index], item.length);
+    unsigned long elapsed = micros() - started;
+
+    xSemaphoreTake(sinkMutex, portMAX_DELAY);
+    sending = false;
+    sinkStats.sendMicros += elapsed;
+    bool done = false;
+    switch (result)
+    {
+    case SINK_SENT:
+        ++sinkStats.sent;
+        sinkStats.bytes += item.length;
+        nextAttemptMs = nowMs;
+        done = true;
+        break;
+
+    case SINK_NOT_READY:
+        nextAttemptMs = nowMs + retryIntervalMs;
+        break;
+
+    case SINK_FAILED:
+        if (++queue[head].attempts >= maxAttempts)
+        {
+            Serial.printf("%s: giving up on datagram after %u attempts\n", sinkName, queue[head].attempts);
+            ++sinkStats.failed;
+            nextAttemptMs = nowMs;
+            done = true;
+        }
+        else
+        {
+            uint8_t shift = queue[head].attempts - 1;
+            if (shift > MAX_BACKOFF_SHIFT)
+                shift = MAX_BACKOFF_SHIFT;
+            ++sinkStats.retries;
+            nextAttemptMs = nowMs + (retryIntervalMs << shift);
+        }
+        break;
+    }
+
+    if (done)
+    {
+        releaseEntry(item.index);
+        head = (head + 1) % DATAGRAM_POOL_SIZE;
+        --count;
+        sinkStats.depth = count;
+    }
+    bool more = done && count > 0;
+    xSemaphoreGive(sinkMutex);
+    return more;
+}
+
+UdpSink::UdpSink(const char *name, const char *host, IPAddress address, uint16_t port,
+                 uint8_t maxAttempts, uint32_t retryIntervalMs)
+    : SpotSink(name, maxAttempts, retryIntervalMs),
+      host(host),
+      fallbackAddress(address),
+      address(address),
+      resolvedMs(0),
+      port(port)
+#ifndef UDP_SINK_BUFFERED
+      ,
+      socketFd(-1)
+#endif
+{
+}
+
+UdpSink::~UdpSink()
+{
+#ifndef UDP_SINK_BUFFERED
+    if (socketFd >= 0)
+        close(socketFd);
+#endif
+}
+
+SinkResult UdpSink::transmit(const uint8_t *data, size_t length)
+{
+    if (WiFi.status() != WL_CONNECTED || WiFi.getMode() != WIFI_STA)
+        return SINK_NOT_READY;
+
+    if (host != NULL && (resolvedMs == 0 || millis() - resolvedMs > RESOLVE_INTERVAL_MS))
+    {
+        IPAddress resolved;
+        if (WiFi.hostByName(host, resolved) == 1 && (uint32_t)resolved != 0)
+        {
+            address = resolved;
+        }
+        else
+        {
+            Serial.printf("%s: failed to resolve %s\n", name(), host);
+            address = fallbackAddress;
+        }
+        resolvedMs = millis() | 1;
+    }
+
+#ifdef UDP_SINK_BUFFERED
+    if ((uint32_t)address == 0 || udp.beginPacket(address, port) == 0)
+    {
+        resolvedMs = 0;
+        return SINK_FAILED;
+    }
+    countCopied(udp.write(data, length));
+    if (udp.endPacket() == 0)
+    {
+        resolvedMs = 0;
+        return SINK_FAILED;
+    }
+#else
+    if ((uint32_t)address == 0)
+    {
+        resolvedMs = 0;
+        return SINK_FAILED;
+    }
+    // the socket outlives the connection, a failed send closes it so the
+    // next attempt starts afresh
+    if (socketFd < 0)
+    {
+        socketFd = socket(AF_INET, SOCK_DGRAM, 0);
+        if (socketFd < 0)
+            return SINK_FAILED;
+    }
+    sockaddr_in destination;
+    memset(&destination, 0, sizeof(destination));
+    destination.sin_family = AF_INET;
+    destination.sin_port = htons(port);
+    destination.sin_addr.s_addr = (uint32_t)address;
+    if (sendto(socketFd, data, length, 0, (const sockaddr *)&destination, sizeof(destination)) != (ssize_t)length)
+    {
+        close(socketFd);
+        socketFd = -1;
+        resolvedMs = 0;
+        return SINK_FAILED;
+    }
+#endif
+    return SINK_SENT;
+}
+
+void initialiseSinks()
+{
+#ifdef STATIC_ALLOCATION
+    static StaticSemaphore_t sinkMutexBuffer;
+    static StaticSemaphore_t sinkSignalBuffer;
+    static StaticSemaphore_t poolSignalBuffer;
+    sinkMutex = xSemaphoreCreateMutexStatic(&sinkMutexBuffer);
+    sinkSignal = xSemaphoreCreateBinaryStatic(&sinkSignalBuffer);
+    poolSignal = xSemaphoreCreateBinaryStatic(&poolSignalBuffer);
+#else
+    sinkMutex = xSemaphoreCreateMutex();
+    sinkSignal = xSemaphoreCreateBinary();
+    poolSignal = xSemaphoreCreateBinary();
+#endif
+    memset(poolUsers, 0, sizeof(poolUsers));
+    memset(poolReserved, 0, sizeof(poolReserved));
+    memset(poolSequence, 0, sizeof(poolSequence));
+}
+
+bool addSink(SpotSink *sink)
+{
+    bool result = false;
+    xSemaphoreTake(sinkMutex, portMAX_DELAY);
+    if (sinkCount < MAX_SINKS)
+    {
+        sinks[sinkCount++] = sink;
+        result = true;
+    }
+    xSemaphoreGive(sinkMutex);
+    return result;
+}
+
+// with the lock held
+static int freeEntry()
+{
+    for (int index = 0; index < DATAGRAM_POOL_SIZE; ++index)
+    {
+        if (poolUsers[index] == 0 && !poolReserved[index])
+            return index;
+    }
+    return -1;
+}
+
+// Every buffer is still queued on a sink that cannot deliver it, so take
+// back the oldest one that is not being sent. One published in the current
+// batch is never taken, it would be lost before the sinks were woken.
+static int reclaimEntry()
+{
+    int oldest = -1;
+    for (int index = 0; index < DATAGRAM_POOL_SIZE; ++index)
+    {
+        if (poolReserved[index])
+            continue;
+        if (batchDepth > 0 && (int32_t)(poolSequence[index] - batchSequence) >= 0)
+            continue;
+        bool inFlight = false;
+        for (int i = 0; i < sinkCount; ++i)
+            inFlight |= sinks[i]->inFlight(index);
+        if (!inFlight && (oldest < 0 || (int32_t)(poolSequence[index] - poolSequence[oldest]) < 0))
+            oldest = index;
+    }
+    if (oldest >= 0)
+    {
+        for (int i = 0; i < sinkCount; ++i)
+            sinks[i]->evict(oldest);
+    }
+    return oldest;
+}
+
+bool acquireDatagram(DatagramHandle &handle)
+{
+    unsigned long started = millis();
+    int index;
+    for (;;)
+    {
+        xSemaphoreTake(sinkMutex, portMAX_DELAY);
+        index = freeEntry();
+        if (index < 0)
+            index = reclaimEntry();
+        if (index >= 0)
+            poolReserved[index] = true;
+        xSemaphoreGive(sinkMutex);
+        if (index >= 0 || batchDepth == 0 || batchStalled)
+            break;
+
+        // every buffer holds part of this batch, let the sinks send some
+        unsigned long waited = millis() - started;
+        if (waited >= DATAGRAM_WAIT_MS)
+        {
+            batchStalled = true;
+            break;
+        }
+        xSemaphoreGive(sinkSignal);
+        xSemaphoreTake(poolSignal, pdMS_TO_TICKS(DATAGRAM_WAIT_MS - waited));
+    }
+
+    handle.index = index;
+    handle.data = index >= 0 ? datagramPool[index] : NULL;
+    return index >= 0;
+}
+
+void publishDatagram(DatagramHandle &handle, size_t length)
+{
+    if (handle.index < 0)
+        return;
+    if (length > MAX_DATAGRAM_SIZE)
+        length = MAX_DATAGRAM_SIZE;
+
+    xSemaphoreTake(sinkMutex, portMAX_DELAY);
+    poolReserved[handle.index] = false;
+    poolSequence[handle.index] = nextSequence++;
+    for (int i = 0; i < sinkCount && !sinksMuted; ++i)
+    {
+        if (sinks[i]->enqueue(handle.index, length))
+            ++poolUsers[handle.index];
+    }
+    xSemaphoreGive(sinkMutex);
+    if (batchDepth > 0)
+        batchPending = true;
+    else
+        xSemaphoreGive(sinkSignal);
+
+    handle.index = -1;
+    handle.data = NULL;
+}
+
+void releaseDatagram(DatagramHandle &handle)
+{
+    if (handle.index < 0)
+        return;
+    xSemaphoreTake(sinkMutex, portMAX_DELAY);
+    poolReserved[handle.index] = false;
+    xSemaphoreGive(sinkMutex);
+    handle.index = -1;
+    handle.data = NULL;
+}
+
+void muteSinks(bool muted)
+{
+    xSemaphoreTake(sinkMutex, portMAX_DELAY);
+    sinksMuted = muted;
+    xSemaphoreGive(sinkMutex);
+}
+
+void beginDatagramBatch()
+{
+    if (batchDepth++ == 0)
+    {
+        xSemaphoreTake(sinkMutex, portMAX_DELAY);
+        batchSequence = nextSequence;
+        xSemaphoreGive(sinkMutex);
+        batchStalled = false;
+    }
+}
+
+void endDatagramBatch()
+{
+    if (batchDepth > 0 && --batchDepth == 0 && batchPending)
+    {
+        batchPending = false;
+        xSemaphoreGive(sinkSignal);
+    }
+}
+
+void waitForSinkWork(uint32_t timeoutMs)
+{
+    xSemaphoreTake(sinkSignal, pdMS_TO_TICKS(timeoutMs));
+}
+
+bool serviceSinks()
+{
+    // one datagram per sink per pass, so a sink that keeps failing only
+    // delays the others by a single attempt
+    bool more = false;
+    for (int i = 0; i < sinkCount; ++i)
+        more |= sinks[i]->service(millis());
+    return more;
+}
+
+bool sinksIdle()
+{
+    bool idle = true;
+    xSemaphoreTake(sinkMutex, portMAX_DELAY);
+    for (int i = 0; i < sinkCount; ++i)
+        idle &= sinks[i]->stats().depth == 0;
+    xSemaphoreGive(sinkMutex);
+    return idle;
+}
+
+size_t getSinkFootprint()
+{
+    return sizeof(datagramPool) + sizeof(poolUsers) + sizeof(poolReserved) + sizeof(poolSequence) + sizeof(sinks);
+}
+
+void printSinkStats()
+{
+    for (int i = 0; i < sinkCount; ++i)
+    {
+        xSemaphoreTake(sinkMutex, portMAX_DELAY);
+        const SinkStats stats = sinks[i]->stats();
+        xSemaphoreGive(sinkMutex);
+        Serial.printf("%-11s sink: depth %d/%d, queued %u, sent %u (%u bytes), retries %u, failed %u, evicted %u\n",
+                      sinks[i]->name(), stats.depth, DATAGRAM_POOL_SIZE, stats.queued, stats.sent,
+                      stats.bytes, stats.retries, stats.failed, stats.evicted);
+        uint32_t attempts = stats.sent + stats.retries + stats.failed;
+        if (attempts > 0)
+            Serial.printf("            %u bytes copied before reaching the stack, %u us a send\n",
+                          stats.copied, stats.sendMicros / attempts);
+    }
+}
@@ -0,0 +1,318 @@
+/* Copyright (c) 2025 Paul Winwood, G8KIG - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the GPL-Version 3 license.
+ *
+ * There is a copy of the GPL-Version 3 license in the same folder as this file.
+ */
+
+#include <ctype.h>
+#include <time.h>
+
+#include <WiFi.h>
+#include <WebServer.h>
+#include <LittleFS.h>
+
+#include "FrameDecoder.h"
+#include "Bands.h"
+#include "SpotHistory.h"
+#include "BandStats.h"
+#include "FrameCapture.h"
+#include "StatusServer.h"
+
+static const int STATUS_SERVER_PORT = 80;
+static const uint32_t DEFAULT_MINUTES = 60;
+static const size_t CAPTURE_CHUNK_SIZE = 1024;
+
+static WebServer server(STATUS_SERVER_PORT);
+static SpotHistory *spotHistory = NULL;
+static BandStats *bandStats = NULL;
+static bool serverStarted = false;
+
+// Streams a response in chunks from a fixed buffer
+class ChunkWriter
+{
+public:
+    ChunkWriter() : used(0)
+    {
+        server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+        server.send(200, "application/json", "");
+    }
+
+    ~ChunkWriter()
+    {
+        flush();
+        server.sendContent("", 0);
+    }
+
+    void printf(const char *fmt, ...)
+    {
+        for (int attempt = 0; attempt < 2; ++attempt)
+        {
+            va_list args;
+            va_start(args, fmt);
+            int size = vsnprintf(buffer + used, sizeof(buffer) - used, fmt, args);
+            va_end(args);
+            if (size >= 0 && used + size < sizeof(buffer))
+            {
+                used += size;
+                return;
+            }
+            flush();
+        }
+    }
+
+    void flush()
+    {
+        if (used > 0)
+            server.sendContent(buffer, used);
+        used = 0;
+    }
+
+private:
+    char buffer[512];
+    size_t used;
+};
+
+static uint32_t sinceFromArgs()
+{
+    uint32_t minutes = DEFAULT_MINUTES;
+    if (server.hasArg("minutes"))
+        minutes = (uint32_t)strtoul(server.arg("minutes").c_str(), NULL, 10);
+    uint32_t now = (uint32_t)time(0);
+    return minutes * 60 < now ? now - minutes * 60 : 0;
+}
+
+// Decoded callsigns are printable ASCII, so only a quote and a backslash
+// need escaping. The text needs room for twice the callsign.
+static void escapeCallsign(const StringView &callsign, char *text)
+{
+    size_t length = 0;
+    for (uint8_t idx = 0; idx < callsign.length; ++idx)
+    {
+        char ch = callsign.data[idx];
+        if (ch == '"' || ch == '\\')
+            text[length++] = '\\';
+        text[length++] = ch;
+    }
+    text[length] = 0;
+}
+
+static void writeSpot(ChunkWriter &writer, const HistorySpot &spot)
+{
+    char callsign[2 * MAX_CALLSIGN_LENGTH + 1];
+    escapeCallsign(spot.callsign, callsign);
+    writer.printf("{\"call\":\"%s\",\"time\":%u,\"band\":\"%s\",\"freq\":%u,\"snr\":%d}",
+                  callsign, spot.time,
+                  spot.band == BAND_UNKNOWN ? "" : bands[spot.band].name, spot.frequency, spot.snr);
+}
+
+struct HeardContext
+{
+    ChunkWriter *writer;
+    bool first;
+};
+
+static void visitHeard(const HistorySpot &spot, void *context)
+{
+    HeardContext *heard = (HeardContext *)context;
+    if (!heard->first)
+        heard->writer->printf(",");
+    heard->first = false;
+    writeSpot(*heard->writer, spot);
+}
+
+static void handleHeard()
+{
+    uint8_t band = BAND_UNKNOWN;
+    if (server.hasArg("band"))
+    {
+        band = bandFromName(server.arg("band").c_str());
+        if (band == BAND_UNKNOWN)
+        {
+            server.send(400, "application/json", "{\"error\":\"unknown band\"}");
+            return;
+        }
+    }
+
+    ChunkWriter writer;
+    HeardContext context = {&writer, true};
+    writer.printf("[");
+    spotHistory->heard(band, sinceFromArgs(), visitHeard, &context);
+    writer.printf("]");
+}
+
+static void handleLastSeen()
+{
+    char callsign[MAX_CALLSIGN_LENGTH + 1];
+    strncpy(callsign, server.arg("call").c_str(), sizeof(callsign) - 1);
+    callsign[sizeof(callsign) - 1] = 0;
+    for (char *p = callsign; *p; ++p)
+        *p = toupper(*p);
+
+    StringView view = {callsign, (uint8_t)strlen(callsign)};
+    HistorySpot spot;
+    uint32_t spotCount = 0;
+    if (!spotHistory->lastSeen(view, spot, spotCount))
+    {
+        server.send(404, "application/json", "{\"error\":\"not heard\"}");
+        return;
+    }
+
+    ChunkWriter writer;
+    writer.printf("{\"spots\":%u,\"last\":", spotCount);
+    writeSpot(writer, spot);
+    writer.printf("}");
+}
+
+static void handleCounts()
+{
+    HistoryCounts counts;
+    spotHistory->counts(sinceFromArgs(), counts);
+
+    ChunkWriter writer;
+    writer.printf("{\"spots\":%u,\"unique\":%u,\"stored\":%u,\"capacity\":%u,\"dropped\":%u,\"bands\":{",
+                  counts.spots, counts.uniqueCallsigns, spotHistory->size(), spotHistory->capacity(),
+                  spotHistory->droppedSpots());
+    bool first = true;
+    for (uint8_t band = 0; band < BAND_COUNT; ++band)
+    {
+        if (counts.bandSpots[band] == 0)
+            continue;
+        writer.printf("%s\"%s\":%u", first ? "" : ",", bands[band].name, counts.bandSpots[band]);
+        first = false;
+    }
+    writer.printf("}}");
+}
+
+static void writeHourStats(ChunkWriter &writer, const BandHourStats &stats)
+{
+    writer.printf("\"spots\":%u,\"unique\":%u,\"snr\":[", stats.spots, stats.unique);
+    for (uint8_t bin = 0; bin < SNR_BINS; ++bin)
+        writer.printf("%s%u", bin == 0 ? "" : ",", stats.snr[bin]);
+    writer.printf("]");
+}
+
+static void handleBands()
+{
+    uint8_t only = BAND_UNKNOWN;
+    if (server.hasArg("band"))
+    {
+        only = bandFromName(server.arg("band").c_str());
+        if (only == BAND_UNKNOWN)
+        {
+            server.send(400, "application/json", "{\"error\":\"unknown band\"}");
+            return;
+        }
+    }
+    uint32_t hours = BAND_STATS_HOURS;
+    if (server.hasArg("hours"))
+        hours = (uint32_t)strtoul(server.arg("hours").c_str(), NULL, 10);
+    if (hours > BAND_STATS_HOURS)
+        hours = BAND_STATS_HOURS;
+
+    ChunkWriter writer;
+    writer.printf("{\"snrFloor\":[null");
+    for (uint8_t bin = 1; bin < SNR_BINS; ++bin)
+        writer.printf(",%d", snrBinFloor[bin]);
+    writer.printf("],\"unbanded\":%u,\"unique\":%u,\"hours\":[",
+                  bandStats->unbandedSpots(), bandStats->uniqueCallsigns(hours, only));
+
+    // newest first, hours without spots are left out
+    bool firstHour = true;
+    for (uint8_t hoursAgo = 0; hoursAgo < hours; ++hoursAgo)
+    {
+        BandHourStats total;
+        if (!bandStats->hourStats(hoursAgo, only, total) || total.spots == 0)
+            continue;
+        writer.printf("%s{\"hour\":%u,", firstHour ? "" : ",", total.hour * 3600);
+        writeHourStats(writer, total);
+        writer.printf(",\"bands\":{");
+        bool firstBand = true;
+        for (uint8_t band = 0; band < BAND_COUNT; ++band)
+        {
+            BandHourStats stats;
+            if ((only != BAND_UNKNOWN && band != only) || !bandStats->hourStats(hoursAgo, band, stats) || stats.spots == 0)
+                continue;
+            writer.printf("%s\"%s\":{", firstBand ? "" : ",", bands[band].name);
+            writeHourStats(writer, stats);
+            writer.printf("}");
+            firstBand = false;
+        }
+        writer.printf("}}");
+        firstHour = false;
+    }
+    writer.printf("]}");
+}
+
+// Serves the capture file, or with ?old=1 the one before it, whether or
+// not a capture is running. The file is sent as it was when the request
+// came, a chunk at a time, and the ring is written out between chunks so
+// a running capture does not drop frames while the download blocks the
+// loop. The file does not start again meanwhile, as that would rename or
+// remove the one being read; it runs on past CAPTURE_FILE_SIZE instead.
+static void handleCapture()
+{
+    bool old = server.hasArg("old") && strtoul(server.arg("old").c_str(), NULL, 10) != 0;
+    const char *path = old ? captureOldPath() : capturePath();
+    bool flushing = captureActive();
+    if (flushing)
+        flushCapture();
+    if (!LittleFS.begin(false) || !LittleFS.exists(path))
+    {
+        server.send(404, "application/json", "{\"error\":\"no capture\"}");
+        return;
+    }
+    File file = LittleFS.open(path, "r");
+    if (!file)
+    {
+        server.send(500, "application/json", "{\"error\":\"cannot read the capture\"}");
+        return;
+    }
+
+    static char chunk[CAPTURE_CHUNK_SIZE];
+    size_t remaining = file.size();
+    server.setContentLength(remaining);
+    server.send(200, "application/octet-stream", "");
+    holdCaptureRollover(true);
+    while (remaining > 0)
+    {
+        size_t length = file.read((uint8_t *)chunk, remaining < sizeof(chunk) ? remaining : sizeof(chunk));
+        if (length == 0)
+        {
+            // short of the length promised, so the client would wait for
+            // the rest; closing tells it the download failed
+            server.client().stop();
+            break;
+        }
+        server.sendContent(chunk, length);
+        remaining -= length;
+        if (flushing)
+            flushCapture();
+    }
+    holdCaptureRollover(false);
+    file.close();
+}
+
+void beginStatusServer(SpotHistory *history, BandStats *stats)
+{
+    spotHistory = history;
+    bandStats = stats;
+    server.on("/heard", HTTP_GET, handleHeard);
+    server.on("/lastseen", HTTP_GET, handleLastSeen);
+    server.on("/counts", HTTP_GET, handleCounts);
+    server.on("/bands", HTTP_GET, handleBands);
+    server.on("/capture", HTTP_GET, handleCapture);
+}
+
+void handleStatusServer()
+{
+    bool connected = WiFi.status() == WL_CONNECTED && WiFi.getMode() == WIFI_STA;
+    if (connected && !serverStarted)
+    {
+        server.begin();
+        serverStarted = true;
+        Serial.printf("Status server on http://%s:%d/\n", WiFi.localIP().toString().c_str(), STATUS_SERVER_PORT);
+    }
+    if (serverStarted)
+        server.handleClient();
+}
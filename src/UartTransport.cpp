@@ -0,0 +1,62 @@
+/* Copyright (c) 2025 Paul Winwood, G8KIG - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the GPL-Version 3 license.
+ *
+ * There is a copy of the GPL-Version 3 license in the same folder as this file.
+ */
+
+#include <Arduino.h>
+#include <HardwareSerial.h>
+
+#include "FrameCodec.h"
+#include "FrameTransport.h"
+#include "UartTransport.h"
+
+// Bytes taken from the driver per read, and the most taken in one poll so
+// a continuous stream cannot hold the loop
+static const size_t READ_CHUNK_SIZE = 256;
+static const size_t MAX_BYTES_PER_POLL = 4096;
+
+UartTransport::UartTransport(HardwareSerial &portIn, uint32_t baudIn, int8_t rxPinIn, int8_t txPinIn)
+    : port(portIn), baud(baudIn), rxPin(rxPinIn), txPin(txPinIn)
+{
+}
+
+bool UartTransport::begin()
+{
+    // a frame of the largest size takes under 200 us at 2 Mbaud, so the
+    // ring buffer has to cover however long the loop is away
+    port.setRxBufferSize(UART_RX_BUFFER_SIZE);
+    port.begin(baud, SERIAL_8N1, rxPin, txPin);
+    // the driver calls back when its FIFO fills or the line goes quiet
+    TransportWakeup wakeup = wakeupHandler;
+    if (wakeup != NULL)
+        port.onReceive([wakeup]() { wakeup(); });
+    return true;
+}
+
+void UartTransport::poll()
+{
+    uint8_t chunk[READ_CHUNK_SIZE];
+    uint32_t started = micros();
+    size_t total = 0;
+    while (total < MAX_BYTES_PER_POLL)
+    {
+        int available = port.available();
+        if (available <= 0)
+            break;
+        size_t length = port.read(chunk, (size_t)available < sizeof(chunk) ? available : sizeof(chunk));
+        if (length == 0)
+            break;
+        receiveBytes(chunk, length);
+        total += length;
+    }
+    uint32_t elapsed = micros() - started;
+    if (elapsed > transportStats.maxPollMicros)
+        transportStats.maxPollMicros = elapsed;
+}
+
+bool UartTransport::writeBytes(const uint8_t *data, size_t length)
+{
+    return port.write(data, length) == length;
+}
@@ -0,0 +1,93 @@
+/* Copyright (c) 2025 Paul Winwood, G8KIG - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the GPL-Version 3 license.
+ *
+ * There is a copy of the GPL-Version 3 license in the same folder as this file.
+ */
+
+#include <WiFi.h>
+#include <Preferences.h>
+#include <esp_wifi.h>
+
+#include "WiFiCache.h"
+
+static const char *const PREFERENCES_NAMESPACE = "wificache";
+static const char *const CONNECTION_KEY = "connection";
+
+static bool loadCachedConnection(CachedConnection &cached)
+{
+    Preferences preferences;
+    if (!preferences.begin(PREFERENCES_NAMESPACE, true))
+        return false;
+    bool result = preferences.getBytes(CONNECTION_KEY, &cached, sizeof(cached)) == sizeof(cached);
+    preferences.end();
+    return result && cached.channel > 0;
+}
+
+bool beginFastReconnect()
+{
+    CachedConnection cached;
+    wifi_config_t config;
+    if (!loadCachedConnection(cached) ||
+        esp_wifi_get_config(WIFI_IF_STA, &config) != ESP_OK ||
+        config.sta.ssid[0] == 0)
+    {
+        return false;
+    }
+
+    // reuse the previous lease rather than wait for DHCP; resumeDhcp()
+    // renews it once joined
+    if (cached.localIP != 0)
+        WiFi.config(IPAddress(cached.localIP), IPAddress(cached.gateway), IPAddress(cached.subnet), IPAddress(cached.dns));
+
+    WiFi.begin((const char *)config.sta.ssid, (const char *)config.sta.password, cached.channel, cached.bssid);
+    return true;
+}
+
+void abandonFastReconnect()
+{
+    WiFi.disconnect();
+    resumeDhcp();
+}
+
+void resumeDhcp()
+{
+    WiFi.config(IPAddress((uint32_t)0), IPAddress((uint32_t)0), IPAddress((uint32_t)0));
+}
+
+void saveCachedConnection()
+{
+    CachedConnection current;
+    memset(&current, 0, sizeof(current));
+    const uint8_t *bssid = WiFi.BSSID();
+    if (bssid == NULL)
+        return;
+    memcpy(current.bssid, bssid, sizeof(current.bssid));
+    current.channel = WiFi.channel();
+    current.localIP = (uint32_t)WiFi.localIP();
+    current.gateway = (uint32_t)WiFi.gatewayIP();
+    current.subnet = (uint32_t)WiFi.subnetMask();
+    current.dns = (uint32_t)WiFi.dnsIP(0);
+
+    // only write the flash when something changed
+    CachedConnection cached;
+    if (loadCachedConnection(cached) && memcmp(&cached, &current, sizeof(current)) == 0)
+        return;
+
+    Preferences preferences;
+    if (preferences.begin(PREFERENCES_NAMESPACE, false))
+    {
+        preferences.putBytes(CONNECTION_KEY, &current, sizeof(current));
+        preferences.end();
+    }
+}
+
+void clearCachedConnection()
+{
+    Preferences preferences;
+    if (preferences.begin(PREFERENCES_NAMESPACE, false))
+    {
+        preferences.remove(CONNECTION_KEY);
+        preferences.end();
+    }
+}
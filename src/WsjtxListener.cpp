@@ -0,0 +1,143 @@
+/* Copyright (c) 2025 Paul Winwood, G8KIG - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the GPL-Version 3 license.
+ *
+ * There is a copy of the GPL-Version 3 license in the same folder as this file.
+ */
+
+#include <time.h>
+
+#include <WiFi.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <unistd.h>
+
+#include "FrameDecoder.h"
+#include "WsjtxParser.h"
+#include "WsjtxListener.h"
+
+#ifndef WSJTX_PORT
+#define WSJTX_PORT WSJTX_DEFAULT_PORT
+#endif
+
+// Datagrams handled per call, so a flood cannot starve the main loop
+static const int MAX_DATAGRAMS_PER_POLL = 16;
+static const size_t MAX_DATAGRAM_SIZE = 1024;
+static const uint32_t LINK_WAIT_MS = 1000; // between looks at the link while it is down
+
+static WsjtxParser *parser = NULL;
+static WsjtxWakeup wakeup = NULL;
+static int wsjtxSocket = -1;
+static TaskHandle_t watcherHandle = 0;
+static volatile bool readable = false; // set by the watcher, cleared by the loop
+
+void beginWsjtxListener(WsjtxSpotHandler handler, void *context, WsjtxWakeup wakeupIn)
+{
+    static WsjtxParser wsjtxParser(handler, context);
+    parser = &wsjtxParser;
+    wakeup = wakeupIn;
+}
+
+static void closeSocket()
+{
+    if (wsjtxSocket >= 0)
+        close(wsjtxSocket);
+    wsjtxSocket = -1;
+}
+
+static bool openSocket()
+{
+    wsjtxSocket = socket(AF_INET, SOCK_DGRAM, 0);
+    if (wsjtxSocket < 0)
+        return false;
+    int reuse = 1;
+    setsockopt(wsjtxSocket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    sockaddr_in local;
+    memset(&local, 0, sizeof(local));
+    local.sin_family = AF_INET;
+    local.sin_port = htons(WSJTX_PORT);
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    bool result = bind(wsjtxSocket, (const sockaddr *)&local, sizeof(local)) == 0;
+#ifdef WSJTX_MULTICAST_GROUP
+    if (result)
+    {
+        IPAddress group;
+        group.fromString(WSJTX_MULTICAST_GROUP);
+        ip_mreq membership;
+        memset(&membership, 0, sizeof(membership));
+        membership.imr_multiaddr.s_addr = (uint32_t)group;
+        membership.imr_interface.s_addr = htonl(INADDR_ANY);
+        result = setsockopt(wsjtxSocket, IPPROTO_IP, IP_ADD_MEMBERSHIP, &membership, sizeof(membership)) == 0;
+    }
+#endif
+    if (!result)
+    {
+        closeSocket();
+        return false;
+    }
+    Serial.printf("Listening for WSJT-X on UDP port %d\n", WSJTX_PORT);
+    return true;
+}
+
+// The watcher owns the socket. It only hands it to the loop while it waits
+// for the loop to finish reading, so the socket is never closed under a read.
+void watchWsjtxListener()
+{
+    watcherHandle = xTaskGetCurrentTaskHandle();
+    bool connected = WiFi.status() == WL_CONNECTED && WiFi.getMode() == WIFI_STA;
+    if (!connected || parser == NULL || (wsjtxSocket < 0 && !openSocket()))
+    {
+        if (!connected)
+            closeSocket();
+        vTaskDelay(pdMS_TO_TICKS(LINK_WAIT_MS));
+        return;
+    }
+
+    // a timeout now and then to notice the link going
+    fd_set waiting;
+    FD_ZERO(&waiting);
+    FD_SET(wsjtxSocket, &waiting);
+    timeval timeout = {(time_t)(LINK_WAIT_MS / 1000), 0};
+    int ready = select(wsjtxSocket + 1, &waiting, NULL, NULL, &timeout);
+    if (ready < 0)
+    {
+        closeSocket();
+        vTaskDelay(pdMS_TO_TICKS(LINK_WAIT_MS));
+        return;
+    }
+    if (ready == 0 || wakeup == NULL)
+        return;
+    readable = true;
+    wakeup();
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+}
+
+void handleWsjtxListener()
+{
+    static uint8_t datagram[MAX_DATAGRAM_SIZE];
+
+    if (!readable)
+        return;
+    for (int count = 0; count < MAX_DATAGRAMS_PER_POLL; ++count)
+    {
+        ssize_t length = recvfrom(wsjtxSocket, datagram, sizeof(datagram), MSG_DONTWAIT, NULL, NULL);
+        if (length <= 0)
+            break;
+        parser->handleDatagram(datagram, (size_t)length, (uint32_t)time(0));
+    }
+    // anything left over makes the socket readable again straight away
+    readable = false;
+    xTaskNotifyGive(watcherHandle);
+}
+
+void printWsjtxStats()
+{
+    if (parser == NULL)
+        return;
+
+    const WsjtxStats &stats = parser->stats();
+    Serial.printf("WSJT-X: %u datagrams from %u clients, %u malformed, %u decodes, %u skipped, %u without status, %u spots accepted\n",
+                  stats.datagrams, stats.clients, stats.malformed, stats.decodes, stats.skipped, stats.noStatus, stats.accepted);
+}
@@ -0,0 +1,293 @@
+/* Copyright (c) 2025 Paul Winwood, G8KIG - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the GPL-Version 3 license.
+ *
+ * There is a copy of the GPL-Version 3 license in the same folder as this file.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "FrameDecoder.h"
+#include "WsjtxParser.h"
+
+static const uint32_t WSJTX_MAGIC = 0xADBCCBDA;
+static const uint32_t WSJTX_MAX_SCHEMA = 3;
+static const uint32_t WSJTX_STATUS = 1;
+static const uint32_t WSJTX_DECODE = 2;
+static const uint32_t QT_NULL_LENGTH = 0xFFFFFFFF;
+
+// Bounded reader for Qt's big-endian QDataStream encoding
+class QDataStreamReader
+{
+public:
+    QDataStreamReader(const uint8_t *data, size_t length)
+        : ptr(data), end(data + length), valid(data != NULL)
+    {
+    }
+
+    bool readUint32(uint32_t &value)
+    {
+        if (!available(4))
+            return false;
+        value = ((uint32_t)ptr[0] << 24) | ((uint32_t)ptr[1] << 16) | ((uint32_t)ptr[2] << 8) | ptr[3];
+        ptr += 4;
+        return true;
+    }
+
+    bool readUint64(uint64_t &value)
+    {
+        uint32_t high = 0;
+        uint32_t low = 0;
+        if (!readUint32(high) || !readUint32(low))
+            return false;
+        value = ((uint64_t)high << 32) | low;
+        return true;
+    }
+
+    bool readBool(bool &value)
+    {
+        if (!available(1))
+            return false;
+        value = *ptr++ != 0;
+        return true;
+    }
+
+    bool skip(size_t count)
+    {
+        if (!available(count))
+            return false;
+        ptr += count;
+        return true;
+    }
+
+    // QByteArray holding UTF-8, a null array reads as empty
+    bool readUtf8(const char *&text, uint32_t &length)
+    {
+        if (!readUint32(length))
+            return false;
+        if (length == QT_NULL_LENGTH)
+            length = 0;
+        if (!available(length))
+            return false;
+        text = reinterpret_cast<const char *>(ptr);
+        ptr += length;
+        return true;
+    }
+
+private:
+    const uint8_t *ptr;
+    const uint8_t *end;
+    bool valid;
+
+    bool available(size_t count)
+    {
+        valid = valid && (size_t)(end - ptr) >= count;
+        return valid;
+    }
+};
+
+static bool isLetter(char ch)
+{
+    return ch >= 'A' && ch <= 'Z';
+}
+
+static bool isDigit(char ch)
+{
+    return ch >= '0' && ch <= '9';
+}
+
+// Letters, digits and '/', with at least one letter and one digit
+static bool looksLikeCallsign(const char *text, size_t length)
+{
+    if (length < 3 || length > 11)
+        return false;
+
+    bool letter = false;
+    bool digit = false;
+    for (size_t idx = 0; idx < length; ++idx)
+    {
+        char ch = text[idx];
+        if (isLetter(ch))
+            letter = true;
+        else if (isDigit(ch))
+            digit = true;
+        else if (ch != '/')
+            return false;
+    }
+    return letter && digit;
+}
+
+bool wsjtxMessageCaller(const char *message, size_t length, StringView &callsign)
+{
+    static const int MAX_TOKENS = 4;
+    const char *tokens[MAX_TOKENS];
+    size_t lengths[MAX_TOKENS];
+    int count = 0;
+
+    size_t idx = 0;
+    while (idx < length && count < MAX_TOKENS)
+    {
+        while (idx < length && message[idx] == ' ')
+            idx++;
+        size_t start = idx;
+        while (idx < length && message[idx] != ' ')
+            idx++;
+        if (idx > start)
+        {
+            tokens[count] = message + start;
+            lengths[count] = idx - start;
+            count++;
+        }
+    }
+    if (count < 2)
+        return false;
+
+    // "CQ K1ABC FN42", "CQ DX K1ABC FN42", otherwise "G8KIG K1ABC -12"
+    int caller = 1;
+    bool cq = (lengths[0] == 2 && memcmp(tokens[0], "CQ", 2) == 0) ||
+              (lengths[0] == 3 && memcmp(tokens[0], "QRZ", 3) == 0);
+    if (cq && count >= 3 && !looksLikeCallsign(tokens[1], lengths[1]))
+        caller = 2;
+
+    const char *text = tokens[caller];
+    size_t textLength = lengths[caller];
+
+    // hashed callsigns are shown in angle brackets, "<...>" is unresolved
+    if (textLength >= 2 && text[0] == '<' && text[textLength - 1] == '>')
+    {
+        text++;
+        textLength -= 2;
+    }
+    if (!looksLikeCallsign(text, textLength))
+        return false;
+
+    callsign.data = text;
+    callsign.length = (uint8_t)textLength;
+    return true;
+}
+
+WsjtxParser::WsjtxParser(WsjtxSpotHandler handlerIn, void *contextIn)
+    : handler(handlerIn), context(contextIn), clientCount(0)
+{
+    memset(&statistics, 0, sizeof(statistics));
+}
+
+const WsjtxStats &WsjtxParser::stats() const
+{
+    return statistics;
+}
+
+// Clients are identified by the id in every message, the least recently
+// heard one is replaced when the table is full
+WsjtxParser::Client *WsjtxParser::findClient(const StringView &id, uint32_t now, bool create)
+{
+    Client *oldest = NULL;
+    for (int idx = 0; idx < clientCount; ++idx)
+    {
+        Client &client = clients[idx];
+        if (id.equals(client.id.data, client.id.length))
+        {
+            client.lastHeard = now;
+            return &client;
+        }
+        if (oldest == NULL || (int32_t)(client.lastHeard - oldest->lastHeard) < 0)
+            oldest = &client;
+    }
+    if (!create)
+        return NULL;
+
+    Client *client = clientCount < MAX_CLIENTS ? clients + clientCount++ : oldest;
+    client->id.assign(id);
+    client->dialFrequency = 0;
+    client->ft8 = false;
+    client->lastHeard = now;
+    statistics.clients++;
+    return client;
+}
+
+void WsjtxParser::handleDatagram(const uint8_t *data, size_t length, uint32_t now)
+{
+    QDataStreamReader reader(data, length);
+    uint32_t magic = 0;
+    uint32_t schema = 0;
+    uint32_t type = 0;
+    const char *idText = NULL;
+    uint32_t idLength = 0;
+
+    statistics.datagrams++;
+    if (!reader.readUint32(magic) || magic != WSJTX_MAGIC ||
+        !reader.readUint32(schema) || schema > WSJTX_MAX_SCHEMA ||
+        !reader.readUint32(type) ||
+        !reader.readUtf8(idText, idLength))
+    {
+        statistics.malformed++;
+        return;
+    }
+
+    StringView id = {idText, (uint8_t)(idLength < MAX_CLIENT_ID_LENGTH ? idLength : MAX_CLIENT_ID_LENGTH)};
+    if (type == WSJTX_STATUS)
+    {
+        uint64_t dialFrequency = 0;
+        const char *mode = NULL;
+        uint32_t modeLength = 0;
+        if (!reader.readUint64(dialFrequency) || !reader.readUtf8(mode, modeLength))
+        {
+            statistics.malformed++;
+            return;
+        }
+        Client *client = findClient(id, now, true);
+        client->dialFrequency = dialFrequency;
+        client->ft8 = modeLength == 3 && memcmp(mode, "FT8", 3) == 0;
+    }
+    else if (type == WSJTX_DECODE)
+    {
+        bool isNew = false;
+        uint32_t timeMs = 0;
+        uint32_t snr = 0;
+        uint32_t deltaFrequency = 0;
+        const char *mode = NULL;
+        uint32_t modeLength = 0;
+        const char *message = NULL;
+        uint32_t messageLength = 0;
+        bool lowConfidence = false;
+        bool offAir = false;
+        if (!reader.readBool(isNew) ||
+            !reader.readUint32(timeMs) ||
+            !reader.readUint32(snr) ||
+            !reader.skip(sizeof(double)) || // delta time
+            !reader.readUint32(deltaFrequency) ||
+            !reader.readUtf8(mode, modeLength) ||
+            !reader.readUtf8(message, messageLength))
+        {
+            statistics.malformed++;
+            return;
+        }
+        // older schemas end before these flags
+        reader.readBool(lowConfidence);
+        reader.readBool(offAir);
+
+        statistics.decodes++;
+        Client *client = findClient(id, now, false);
+        if (client == NULL || client->dialFrequency == 0)
+        {
+            statistics.noStatus++;
+            return;
+        }
+
+        ReceivedRecordView record;
+        bool ft8 = client->ft8 && modeLength == 1 && mode[0] == '~';
+        if (!isNew || offAir || lowConfidence || !ft8 ||
+            !wsjtxMessageCaller(message, messageLength, record.callsign))
+        {
+            statistics.skipped++;
+            return;
+        }
+
+        record.packed = 0;
+        record.frequency = (uint32_t)(client->dialFrequency + deltaFrequency);
+        record.snr = (uint8_t)(int8_t)(int32_t)snr;
+        if (handler(record, context))
+            statistics.accepted++;
+    }
+}
@@ -0,0 +1,93 @@
+/* Copyright (c) 2025 Paul Winwood, G8KIG - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the GPL-Version 3 license.
+ *
+ * There is a copy of the GPL-Version 3 license in the same folder as this file.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef ESP_PLATFORM
+#include <esp_rom_crc.h>
+#endif
+
+#include "crc.h"
+
+#ifdef ESP_PLATFORM
+
+uint32_t crc32(const uint8_t *message, size_t messageSize)
+{
+    // the ROM routine inverts before and after itself
+    return esp_rom_crc32_le(0, message, messageSize);
+}
+
+#else
+
+// Slice by 4: table[k][b] is the CRC of byte b followed by k zero bytes
+struct Crc32Tables
+{
+    uint32_t table[4][256];
+};
+
+static constexpr Crc32Tables makeCrc32Tables()
+{
+    Crc32Tables tables = {};
+    for (uint32_t byte = 0; byte < 256; ++byte)
+    {
+        uint32_t crc = byte;
+        for (int bit = 0; bit < 8; ++bit)
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        tables.table[0][byte] = crc;
+    }
+    for (uint32_t byte = 0; byte < 256; ++byte)
+    {
+        for (int k = 1; k < 4; ++k)
+        {
+            uint32_t previous = tables.table[k - 1][byte];
+            tables.table[k][byte] = (previous >> 8) ^ tables.table[0][previous & 0xFF];
+        }
+    }
+    return tables;
+}
+
+static constexpr Crc32Tables crcTables = makeCrc32Tables();
+
+uint32_t crc32(const uint8_t *message, size_t messageSize)
+{
+    const uint32_t(*table)[256] = crcTables.table;
+    uint32_t crc = 0xFFFFFFFF;
+    while (messageSize >= 4)
+    {
+        crc ^= message[0] | (message[1] << 8) | (message[2] << 16) | ((uint32_t)message[3] << 24);
+        crc = table[3][crc & 0xFF] ^ table[2][(crc >> 8) & 0xFF] ^ table[1][(crc >> 16) & 0xFF] ^ table[0][crc >> 24];
+        message += 4;
+        messageSize -= 4;
+    }
+    while (messageSize-- > 0)
+        crc = table[0][(crc ^ *message++) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+#endif
+
+size_t appendCrc32(uint8_t *message, size_t messageSize)
+{
+    uint32_t crc = crc32(message, messageSize);
+    uint8_t *trailer = message + messageSize;
+    trailer[0] = (uint8_t)crc;
+    trailer[1] = (uint8_t)(crc >> 8);
+    trailer[2] = (uint8_t)(crc >> 16);
+    trailer[3] = (uint8_t)(crc >> 24);
+    return messageSize + CRC32_TRAILER_SIZE;
+}
+
+bool checkCrc32(const uint8_t *message, size_t sizeWithTrailer)
+{
+    if (sizeWithTrailer < CRC32_TRAILER_SIZE)
+        return false;
+    size_t size = sizeWithTrailer - CRC32_TRAILER_SIZE;
+    const uint8_t *trailer = message + size;
+    uint32_t received = trailer[0] | (trailer[1] << 8) | (trailer[2] << 16) | ((uint32_t)trailer[3] << 24);
+    return received == crc32(message, size);
+}
@@ -0,0 +1,208 @@
+/* Copyright (c) 2025 Paul Winwood, G8KIG - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the GPL-Version 3 license.
+ *
+ * There is a copy of the GPL-Version 3 license in the same folder as this file.
+ */
+
+#include <new>
+
+#include <pthread.h>
+
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+
+#include "HeapArena.h"
+
+// Every block starts with its header; blocks follow each other to the end
+// of the arena, so the next block is found from the size
+struct BlockHeader
+{
+    uint32_t size; // including the header, a multiple of 8
+    uint32_t used;
+};
+
+static const size_t ALIGNMENT = 8;
+static const size_t MIN_SPLIT = sizeof(BlockHeader) + ALIGNMENT;
+
+static pthread_mutex_t arenaMutex = PTHREAD_MUTEX_INITIALIZER;
+static uint8_t *arena = NULL;
+static size_t arenaSize = 0;
+static bool arenaActive = false;
+static size_t allocatedBytes = 0;
+static size_t allocatedBlocks = 0;
+static size_t minimumFree = 0;
+
+static BlockHeader *blockAt(size_t offset)
+{
+    return (BlockHeader *)(arena + offset);
+}
+
+static bool inArena(const void *ptr)
+{
+    return arena != NULL && (const uint8_t *)ptr >= arena && (const uint8_t *)ptr < arena + arenaSize;
+}
+
+// with the lock held
+static void *arenaAllocate(size_t size)
+{
+    size_t needed = (size + sizeof(BlockHeader) + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+    for (size_t offset = 0; offset < arenaSize; offset += blockAt(offset)->size)
+    {
+        BlockHeader *block = blockAt(offset);
+        if (block->used || block->size < needed)
+            continue;
+        if (block->size - needed >= MIN_SPLIT)
+        {
+            BlockHeader *rest = blockAt(offset + needed);
+            rest->size = block->size - needed;
+            rest->used = 0;
+            block->size = needed;
+        }
+        block->used = 1;
+        allocatedBytes += block->size;
+        ++allocatedBlocks;
+        if (arenaSize - allocatedBytes < minimumFree)
+            minimumFree = arenaSize - allocatedBytes;
+        return block + 1;
+    }
+    return NULL;
+}
+
+// with the lock held, joins the block to free neighbours on both sides
+static void arenaFree(void *ptr)
+{
+    BlockHeader *block = (BlockHeader *)ptr - 1;
+    size_t offset = (uint8_t *)block - arena;
+    block->used = 0;
+    allocatedBytes -= block->size;
+    --allocatedBlocks;
+
+    while (offset + block->size < arenaSize && !blockAt(offset + block->size)->used)
+        block->size += blockAt(offset + block->size)->size;
+
+    for (size_t previous = 0; previous < offset; previous += blockAt(previous)->size)
+    {
+        if (previous + blockAt(previous)->size == offset)
+        {
+            if (!blockAt(previous)->used)
+                blockAt(previous)->size += block->size;
+            break;
+        }
+    }
+}
+
+bool heapArenaBegin(size_t size)
+{
+    size &= ~(ALIGNMENT - 1);
+    uint8_t *memory = (uint8_t *)aligned_alloc(ALIGNMENT, size);
+    if (memory == NULL)
+        return false;
+
+    pthread_mutex_lock(&arenaMutex);
+    // a previous arena may still hold blocks, so it is never given back
+    arena = memory;
+    arenaSize = size;
+    blockAt(0)->size = (uint32_t)size;
+    blockAt(0)->used = 0;
+    allocatedBytes = 0;
+    allocatedBlocks = 0;
+    minimumFree = size;
+    arenaActive = true;
+    pthread_mutex_unlock(&arenaMutex);
+    return true;
+}
+
+void heapArenaEnd()
+{
+    pthread_mutex_lock(&arenaMutex);
+    arenaActive = false;
+    pthread_mutex_unlock(&arenaMutex);
+}
+
+void *heap_caps_malloc(size_t size, uint32_t caps)
+{
+    pthread_mutex_lock(&arenaMutex);
+    void *ptr = arenaActive ? arenaAllocate(size > 0 ? size : 1) : malloc(size);
+    pthread_mutex_unlock(&arenaMutex);
+    return ptr;
+}
+
+void heap_caps_free(void *ptr)
+{
+    if (ptr == NULL)
+        return;
+    pthread_mutex_lock(&arenaMutex);
+    if (inArena(ptr))
+        arenaFree(ptr);
+    else
+        free(ptr);
+    pthread_mutex_unlock(&arenaMutex);
+}
+
+void heap_caps_get_info(multi_heap_info_t *info, uint32_t caps)
+{
+    memset(info, 0, sizeof(*info));
+    pthread_mutex_lock(&arenaMutex);
+    if (arena != NULL)
+    {
+        for (size_t offset = 0; offset < arenaSize; offset += blockAt(offset)->size)
+        {
+            const BlockHeader *block = blockAt(offset);
+            if (!block->used)
+            {
+                info->total_free_bytes += block->size;
+                if (block->size > info->largest_free_block)
+                    info->largest_free_block = block->size;
+                ++info->free_blocks;
+            }
+            ++info->total_blocks;
+        }
+        info->total_allocated_bytes = allocatedBytes;
+        info->allocated_blocks = allocatedBlocks;
+        info->minimum_free_bytes = minimumFree;
+    }
+    pthread_mutex_unlock(&arenaMutex);
+}
+
+// The board aborts when the heap is exhausted, and so does this
+static void *allocateOrAbort(size_t size)
+{
+    void *ptr = heap_caps_malloc(size, MALLOC_CAP_8BIT);
+    if (ptr == NULL)
+    {
+        Serial.printf("heap exhausted allocating %zu bytes\n", size);
+        abort();
+    }
+    return ptr;
+}
+
+void *operator new(size_t size)
+{
+    return allocateOrAbort(size);
+}
+
+void *operator new[](size_t size)
+{
+    return allocateOrAbort(size);
+}
+
+void operator delete(void *ptr) noexcept
+{
+    heap_caps_free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+    heap_caps_free(ptr);
+}
+
+void operator delete(void *ptr, size_t size) noexcept
+{
+    heap_caps_free(ptr);
+}
+
+void operator delete[](void *ptr, size_t size) noexcept
+{
+    heap_caps_free(ptr);
+}
@@ -0,0 +1,16 @@
+/* Copyright (c) 2025 Paul Winwood, G8KIG - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the GPL-Version 3 license.
+ *
+ * There is a copy of the GPL-Version 3 license in the same folder as this file.
+ */
+
+#pragma once
+
+// A first fit heap in one fixed block, standing in for the board's heap so
+// the soak test can see fragmentation as well as use. While it is active
+// operator new and heap_caps_malloc() allocate from it, and
+// heap_caps_get_info() describes it. Memory from before it began is still
+// freed to malloc.
+bool heapArenaBegin(size_t size);
+void heapArenaEnd(); // later allocations come from malloc again
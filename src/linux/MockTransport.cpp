@@ -0,0 +1,187 @@
+/* Copyright (c) 2025 Paul Winwood, G8KIG - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the GPL-Version 3 license.
+ *
+ * There is a copy of the GPL-Version 3 license in the same folder as this file.
+ */
+
+#include <vector>
+
+#include <Arduino.h>
+
+#include "main.h"
+#include "crc.h"
+#include "LatencyHistogram.h"
+#include "workqueue.h"
+#include "FrameCodec.h"
+#include "FrameTransport.h"
+#include "MockTransport.h"
+#include "LoadGenerator.h"
+
+MockTransport::MockTransport(const uint8_t *streamIn, size_t lengthIn, size_t chunkSizeIn)
+    : stream(streamIn), length(lengthIn), chunkSize(chunkSizeIn > 0 ? chunkSizeIn : 1), position(0), replied(0)
+{
+}
+
+bool MockTransport::begin()
+{
+    position = 0;
+    replied = 0;
+    return true;
+}
+
+void MockTransport::poll()
+{
+    size_t size = length - position < chunkSize ? length - position : chunkSize;
+    receiveBytes(stream + position, size);
+    position += size;
+}
+
+bool MockTransport::writeBytes(const uint8_t *data, size_t size)
+{
+    replied += size;
+    return true;
+}
+
+static uint64_t nowNanos()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+// The byte at a time CRC this replaced, to compare against
+static uint32_t bitwiseCrc32(const uint8_t *message, size_t messageSize)
+{
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t idx = 0; idx < messageSize; ++idx)
+    {
+        crc ^= message[idx];
+        for (int j = 7; j >= 0; j--)
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+    }
+    return ~crc;
+}
+
+// Nanoseconds a frame to check every frame's CRC
+static double crcNanosPerFrame(uint32_t (*crc)(const uint8_t *, size_t), const std::vector<uint8_t> &frames,
+                               const std::vector<uint8_t> &frameLengths)
+{
+    volatile uint32_t sink = 0;
+    uint64_t started = nowNanos();
+    size_t offset = 0;
+    for (size_t idx = 0; idx < frameLengths.size(); ++idx)
+    {
+        sink = sink ^ crc(&frames[offset], frameLengths[idx]);
+        offset += frameLengths[idx];
+    }
+    return (double)(nowNanos() - started) / frameLengths.size();
+}
+
+// Frames per second a link can carry: 10 bits a byte on a UART, 9 a byte
+// plus start, address and stop on I2C
+static double uartFramesPerSecond(double baud, double encodedBytes)
+{
+    return baud / (10.0 * encodedBytes);
+}
+
+static double i2cFramesPerSecond(double clock, double frameBytes)
+{
+    return clock / (9.0 * (frameBytes + 1) + 2);
+}
+
+void runTransportBenchmark(const TransportBenchmarkConfig &config,
+                           FrameHandler frameHandler, ReplySource replySource, void *context)
+{
+    std::vector<uint8_t> frames;
+    std::vector<uint8_t> frameLengths;
+    frames.reserve((size_t)config.frames * MAX_FRAME_SIZE);
+    frameLengths.reserve(config.frames);
+
+    for (uint32_t idx = 0; idx < config.frames; ++idx)
+    {
+        uint8_t frame[MAX_FRAME_SIZE];
+        size_t length;
+        if (config.timeEvery > 0 && idx % config.timeEvery == 0)
+        {
+            frame[0] = OP_TIME_REQUEST;
+            length = 1;
+        }
+        else
+        {
+            char callsign[12];
+            stationCallsign(idx % 10000, callsign);
+            uint32_t frequency = 14074000 + idx % 3000;
+            uint8_t snr = (uint8_t)(idx % 50 - 25);
+            if (config.packed)
+            {
+                frame[0] = OP_PACKED_RECEIVER_RECORD;
+                length = 1 + encodePackedReceivedRecord(frame + 1, sizeof(frame) - 1, callsign, frequency, snr);
+            }
+            else
+            {
+                frame[0] = OP_RECEIVER_RECORD;
+                length = 1 + encodeReceivedRecord(frame + 1, sizeof(frame) - 1, callsign, frequency, snr);
+            }
+        }
+        frames.insert(frames.end(), frame, frame + length);
+        frameLengths.push_back((uint8_t)length);
+    }
+
+    std::vector<uint8_t> stream((size_t)config.frames * MAX_ENCODED_FRAME_SIZE);
+    uint64_t started = nowNanos();
+    size_t streamLength = 0;
+    size_t offset = 0;
+    for (uint32_t idx = 0; idx < config.frames; ++idx)
+    {
+        streamLength += encodeFrame(&frames[offset], frameLengths[idx], &stream[streamLength], stream.size() - streamLength);
+        offset += frameLengths[idx];
+    }
+    uint64_t encodeNanos = nowNanos() - started;
+
+    // damage a byte in the middle of every nth frame, which the CRC or the
+    // decoder has to catch
+    uint32_t corrupted = 0;
+    if (config.corruptEvery > 0)
+    {
+        size_t position = 0;
+        for (uint32_t idx = 0; idx < config.frames; ++idx)
+        {
+            size_t end = position;
+            while (stream[end] != 0)
+                ++end;
+            if (idx % config.corruptEvery == config.corruptEvery - 1)
+            {
+                stream[position + (end - position) / 2] ^= 0x10;
+                ++corrupted;
+            }
+            position = end + 1;
+        }
+    }
+
+    MockTransport transport(stream.data(), streamLength, config.chunkSize);
+    transport.setHandlers(frameHandler, replySource, context);
+    transport.begin();
+    started = nowNanos();
+    while (!transport.finished())
+        transport.poll();
+    uint64_t decodeNanos = nowNanos() - started;
+
+    const TransportStats &stats = transport.stats();
+    double encodedPerFrame = (double)streamLength / config.frames;
+    double framePerFrame = (double)frames.size() / config.frames;
+    Serial.printf("Transport benchmark: %u %sframes in %zu byte chunks, %u corrupted\n",
+                  config.frames, config.packed ? "packed " : "", config.chunkSize, corrupted);
+    Serial.printf("  %.1f bytes a frame, %.1f encoded (%.0f%% overhead)\n",
+                  framePerFrame, encodedPerFrame, 100.0 * (encodedPerFrame - framePerFrame) / framePerFrame);
+    Serial.printf("  encode %.0f ns a frame, decode and dispatch %.0f ns a frame, %.0f frames/s\n",
+                  (double)encodeNanos / config.frames, (double)decodeNanos / config.frames,
+                  config.frames * 1e9 / (decodeNanos > 0 ? decodeNanos : 1));
+    Serial.printf("  CRC-32 %.1f ns a frame, %.1f ns byte at a time\n",
+                  crcNanosPerFrame(crc32, frames, frameLengths), crcNanosPerFrame(bitwiseCrc32, frames, frameLengths));
+    Serial.printf("  delivered %u, corrupt %u, CRC errors %u, overruns %u, %u replies of %zu bytes\n",
+                  stats.frames, stats.corrupt, stats.crcErrors, stats.overruns, stats.replies, transport.replyBytes());
+    Serial.printf("  link capacity in frames/s: UART 2 Mbaud %.0f, 1 Mbaud %.0f, I2C 400 kHz %.0f, 100 kHz %.0f\n",
+                  uartFramesPerSecond(2000000, encodedPerFrame), uartFramesPerSecond(1000000, encodedPerFrame),
+                  i2cFramesPerSecond(400000, framePerFrame), i2cFramesPerSecond(100000, framePerFrame));
+}
@@ -0,0 +1,48 @@
+/* Copyright (c) 2025 Paul Winwood, G8KIG - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the GPL-Version 3 license.
+ *
+ * There is a copy of the GPL-Version 3 license in the same folder as this file.
+ */
+
+#pragma once
+
+// Plays a byte stream from memory as if it came off a UART, a chunk per
+// poll(), so the framing can be measured without hardware. Replies are
+// counted and thrown away.
+class MockTransport final : public StreamTransport
+{
+public:
+    MockTransport(const uint8_t *stream, size_t length, size_t chunkSize);
+
+    bool begin() override;
+    void poll() override;
+    const char *name() const override { return "mock"; }
+
+    bool finished() const { return position >= length; }
+    size_t replyBytes() const { return replied; }
+
+protected:
+    bool writeBytes(const uint8_t *data, size_t length) override;
+
+private:
+    const uint8_t *stream;
+    size_t length;
+    size_t chunkSize;
+    size_t position;
+    size_t replied;
+};
+
+struct TransportBenchmarkConfig
+{
+    uint32_t frames;
+    size_t chunkSize;      // bytes per poll, as a UART read would return them
+    uint32_t corruptEvery; // flip a bit in every nth frame, 0 for none
+    uint32_t timeEvery;    // every nth frame is a time request, 0 for none
+    bool packed;           // spots with packed callsigns
+};
+
+// Encodes the frames, plays them through a MockTransport to the handlers
+// and reports the cost of each side and what the links could carry
+void runTransportBenchmark(const TransportBenchmarkConfig &config,
+                           FrameHandler frameHandler, ReplySource replySource, void *context);
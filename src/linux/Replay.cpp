@@ -0,0 +1,146 @@
+/* Copyright (c) 2025 Paul Winwood, G8KIG - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the GPL-Version 3 license.
+ *
+ * There is a copy of the GPL-Version 3 license in the same folder as this file.
+ */
+
+#include <unistd.h>
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <LittleFS.h>
+
+#include "main.h"
+#include "crc.h"
+#include "LatencyHistogram.h"
+#include "workqueue.h"
+#include "FrameDecoder.h"
+#include "RecordStore.h"
+#include "Bands.h"
+#include "SpotHistory.h"
+#include "BandStats.h"
+#include "IngressFilter.h"
+#include "SpotSink.h"
+#include "PSKReporter.h"
+#include "ReporterSet.h"
+#include "FrameCapture.h"
+#include "Replay.h"
+
+static const char *const operationNames[OP_PACKED_RECEIVER_RECORD + 1] = {
+    "time requests", "sender records", "software records", "spots", "send requests", "packed spots"};
+
+static uint64_t nowMicros()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000ULL + now.tv_nsec / 1000;
+}
+
+// Each frame's CRC is taken over the one before it as well, so the result
+// depends on the order too
+static uint32_t addToFingerprint(uint32_t fingerprint, const uint8_t *frame, size_t length)
+{
+    uint8_t buffer[4 + 255];
+    memcpy(buffer, &fingerprint, 4);
+    memcpy(buffer + 4, frame, length);
+    return crc32(buffer, 4 + length);
+}
+
+bool runReplay(const ReplayConfig &config, ReporterSet &reporters, ReplayReport &report)
+{
+    memset(&report.operations, 0, sizeof(report.operations));
+    report.frames = 0;
+    report.recordsFlushed = 0;
+    report.fingerprint = 0;
+    report.capturedMicros = 0;
+    report.busyMicros = 0;
+    report.ingest.reset();
+    report.flush.reset();
+
+    CaptureReader reader;
+    if (!reader.open(config.path))
+    {
+        Serial.printf("%s is not a frame capture\n", config.path);
+        return false;
+    }
+
+    muteSinks(true);
+    resetWorkQueueStats();
+    uint64_t started = nowMicros();
+    uint32_t delta;
+    uint8_t frame[255];
+    size_t length;
+    while (reader.next(delta, frame, length))
+    {
+        report.capturedMicros += delta;
+        uint64_t due = started;
+        if (config.speed > 0)
+        {
+            due += (uint64_t)(report.capturedMicros / config.speed);
+            uint64_t now = nowMicros();
+            if (due > now)
+            {
+                // oversleeping is the replay's delay, not the bridge's, so
+                // the schedule moves with it
+                usleep(due - now);
+                uint64_t woke = nowMicros();
+                started += woke - due;
+                due = woke;
+            }
+        }
+
+        uint64_t handled = nowMicros();
+        if (config.speed <= 0)
+            due = handled;
+        I2COperation operation = frameOperation(frame[0]);
+        if (operation == OP_SEND_REQUEST)
+            report.recordsFlushed += reporters.pendingRecords();
+        handleReceivedFrame(frame, length);
+        while (processWorkQueue())
+            ;
+        uint64_t done = nowMicros();
+
+        report.busyMicros += done - handled;
+        if (operation == OP_RECEIVER_RECORD || operation == OP_PACKED_RECEIVER_RECORD)
+            report.ingest.record((uint32_t)(done - due));
+        else if (operation == OP_SEND_REQUEST)
+            report.flush.record((uint32_t)(done - due));
+        if (operation <= OP_PACKED_RECEIVER_RECORD)
+            ++report.operations[operation];
+        report.fingerprint = addToFingerprint(report.fingerprint, frame, length);
+        ++report.frames;
+    }
+    report.elapsedMicros = nowMicros() - started;
+    getWorkQueueStats(report.queue);
+    muteSinks(false);
+    return report.frames > 0;
+}
+
+void printReplayReport(const ReplayConfig &config, const ReplayReport &report)
+{
+    Serial.printf("Replay of %s: %u frames spanning %.1f s, fingerprint %08x\n",
+                  config.path, report.frames, report.capturedMicros / 1e6, report.fingerprint);
+    for (int operation = 0; operation <= OP_PACKED_RECEIVER_RECORD; ++operation)
+        Serial.printf("  %-17s %u\n", operationNames[operation], report.operations[operation]);
+    Serial.printf("  records flushed   %u\n", report.recordsFlushed);
+    if (config.speed > 0)
+        Serial.printf("  at %.1fx took %.1f s\n", config.speed, report.elapsedMicros / 1e6);
+    else
+        Serial.printf("  flat out took %.3f s\n", report.elapsedMicros / 1e6);
+    Serial.printf("  %.0f frames/s while busy, %.2f us a frame\n",
+                  report.busyMicros > 0 ? report.frames * 1e6 / report.busyMicros : 0.0,
+                  report.frames > 0 ? (double)report.busyMicros / report.frames : 0.0);
+    Serial.printf("  spot latency    p50 %u us, p90 %u us, p99 %u us, max %u us\n",
+                  report.ingest.percentile(50), report.ingest.percentile(90),
+                  report.ingest.percentile(99), report.ingest.maximum());
+    Serial.printf("  flush latency   p50 %u us, p99 %u us, max %u us\n",
+                  report.flush.percentile(50), report.flush.percentile(99), report.flush.maximum());
+    for (int lane = 0; lane < LANE_COUNT; ++lane)
+    {
+        const WorkLaneStats &stats = report.queue.lanes[lane];
+        Serial.printf("  %-7s lane      queued %u, coalesced %u, dropped %u, high water %d\n",
+                      lane == LANE_CONTROL ? "control" : "bulk", stats.queued, stats.coalesced,
+                      stats.dropped, stats.highWater);
+    }
+}
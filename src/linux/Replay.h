@@ -0,0 +1,36 @@
+/* Copyright (c) 2025 Paul Winwood, G8KIG - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the GPL-Version 3 license.
+ *
+ * There is a copy of the GPL-Version 3 license in the same folder as this file.
+ */
+
+#pragma once
+
+// Plays a capture made by FrameCapture through handleReceivedFrame(), the
+// work queue and the reporters, as frames from the serial port would go,
+// at the pace it was recorded or faster. Published datagrams are discarded.
+// The counts depend only on the capture, so reports from two builds given
+// the same file line up, and only the timings should differ.
+struct ReplayConfig
+{
+    const char *path = NULL;
+    double speed = 1.0; // 1 as recorded, 10 ten times faster, 0 flat out
+};
+
+struct ReplayReport
+{
+    uint32_t frames;
+    uint32_t operations[OP_PACKED_RECEIVER_RECORD + 1]; // frames of each operation
+    uint32_t recordsFlushed;                            // records waiting at each send request
+    uint32_t fingerprint;                               // CRC of the frames, to tell captures apart
+    uint64_t capturedMicros;                            // time the capture spans
+    uint64_t elapsedMicros;                             // time the replay took
+    uint64_t busyMicros;                                // time spent handling frames
+    LatencyHistogram ingest;                            // spot due until processed
+    LatencyHistogram flush;                             // send request due until encoded
+    WorkQueueStats queue;
+};
+
+bool runReplay(const ReplayConfig &config, ReporterSet &reporters, ReplayReport &report);
+void printReplayReport(const ReplayConfig &config, const ReplayReport &report);
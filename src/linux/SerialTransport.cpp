@@ -0,0 +1,97 @@
+/* Copyright (c) 2025 Paul Winwood, G8KIG - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the GPL-Version 3 license.
+ *
+ * There is a copy of the GPL-Version 3 license in the same folder as this file.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <Arduino.h>
+
+#include "FrameCodec.h"
+#include "FrameTransport.h"
+#include "SerialTransport.h"
+
+SerialTransport::SerialTransport(const char *deviceIn, speed_t baudIn)
+    : device(deviceIn), baud(baudIn), serialFd(-1)
+{
+}
+
+SerialTransport::~SerialTransport()
+{
+    close();
+}
+
+bool SerialTransport::begin()
+{
+    close();
+    serialFd = open(device, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (serialFd < 0)
+    {
+        Serial.printf("Cannot open %s: %s\n", device, strerror(errno));
+        return false;
+    }
+
+    termios tio;
+    if (tcgetattr(serialFd, &tio) == 0)
+    {
+        cfmakeraw(&tio);
+        cfsetispeed(&tio, baud);
+        cfsetospeed(&tio, baud);
+        tcsetattr(serialFd, TCSANOW, &tio);
+    }
+    Serial.printf("Reading frames from %s\n", device);
+    return true;
+}
+
+void SerialTransport::poll()
+{
+    uint8_t data[256];
+    uint32_t started = micros();
+    while (serialFd >= 0)
+    {
+        ssize_t length = read(serialFd, data, sizeof(data));
+        if (length > 0)
+        {
+            receiveBytes(data, length);
+        }
+        else if (length < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        else
+        {
+            if (length == 0 || errno != EAGAIN)
+            {
+                // the other end went away
+                Serial.printf("Lost %s\n", device);
+                close();
+            }
+            break;
+        }
+    }
+    uint32_t elapsed = micros() - started;
+    if (elapsed > transportStats.maxPollMicros)
+        transportStats.maxPollMicros = elapsed;
+}
+
+void SerialTransport::close()
+{
+    if (serialFd >= 0)
+        ::close(serialFd);
+    serialFd = -1;
+}
+
+bool SerialTransport::writeBytes(const uint8_t *data, size_t length)
+{
+    if (serialFd < 0 || write(serialFd, data, length) != (ssize_t)length)
+    {
+        Serial.printf("Failed to write to %s\n", device);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,32 @@
+/* Copyright (c) 2025 Paul Winwood, G8KIG - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the GPL-Version 3 license.
+ *
+ * There is a copy of the GPL-Version 3 license in the same folder as this file.
+ */
+
+#pragma once
+
+// Frames from a serial port or pty, read when epoll says there is data.
+// A hangup closes the port; the owner opens it again with begin().
+class SerialTransport final : public StreamTransport
+{
+public:
+    SerialTransport(const char *device, speed_t baud);
+    ~SerialTransport();
+
+    bool begin() override;
+    void poll() override;
+    const char *name() const override { return "serial"; }
+
+    int fd() const { return serialFd; }
+    void close();
+
+protected:
+    bool writeBytes(const uint8_t *data, size_t length) override;
+
+private:
+    const char *device;
+    speed_t baud;
+    int serialFd;
+};
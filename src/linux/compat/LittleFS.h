@@ -0,0 +1,44 @@
+/* Copyright (c) 2025 Paul Winwood, G8KIG - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the GPL-Version 3 license.
+ *
+ * There is a copy of the GPL-Version 3 license in the same folder as this file.
+ */
+
+// Files on the host file system, paths taken as they are. A File is a
+// handle, as on the ESP32, so copies share the one open file and it stays
+// open until close() is called.
+
+#pragma once
+
+#include <Arduino.h>
+
+class File
+{
+public:
+    File() : file(NULL) {}
+    explicit File(FILE *fileIn) : file(fileIn) {}
+
+    size_t write(const uint8_t *data, size_t size);
+    size_t read(uint8_t *data, size_t size);
+    size_t size();
+    void flush();
+    void close();
+
+    operator bool() const { return file != NULL; }
+
+private:
+    FILE *file;
+};
+
+class LittleFSClass
+{
+public:
+    bool begin(bool formatOnFail = false) { return true; }
+    File open(const char *path, const char *mode);
+    bool exists(const char *path);
+    bool remove(const char *path);
+    bool rename(const char *from, const char *to);
+};
+
+extern LittleFSClass LittleFS;
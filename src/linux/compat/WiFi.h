@@ -0,0 +1,73 @@
+/* Copyright (c) 2025 Paul Winwood, G8KIG - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the GPL-Version 3 license.
+ *
+ * There is a copy of the GPL-Version 3 license in the same folder as this file.
+ */
+
+// The network is the host's, so it is always up and UDP goes straight to
+// a POSIX socket
+
+#pragma once
+
+#include <netinet/in.h>
+
+#include <Arduino.h>
+
+typedef enum
+{
+    WL_IDLE_STATUS = 0,
+    WL_CONNECTED = 3,
+    WL_DISCONNECTED = 6
+} wl_status_t;
+
+typedef enum
+{
+    WIFI_OFF = 0,
+    WIFI_STA = 1
+} wifi_mode_t;
+
+class IPAddress
+{
+public:
+    IPAddress() : address(0) {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+        : address(htonl(((uint32_t)a << 24) | ((uint32_t)b << 16) | ((uint32_t)c << 8) | d)) {}
+    explicit IPAddress(uint32_t networkOrder) : address(networkOrder) {}
+
+    operator uint32_t() const { return address; }
+    bool fromString(const char *text);
+
+private:
+    uint32_t address; // network byte order
+};
+
+class WiFiClass
+{
+public:
+    wl_status_t status() { return WL_CONNECTED; }
+    wifi_mode_t getMode() { return WIFI_STA; }
+    int hostByName(const char *host, IPAddress &result);
+};
+
+extern WiFiClass WiFi;
+
+class WiFiUDP
+{
+public:
+    WiFiUDP();
+    ~WiFiUDP();
+
+    int beginPacket(IPAddress address, uint16_t port);
+    size_t write(const uint8_t *data, size_t size);
+    int endPacket();
+    void stop();
+
+    WiFiUDP &operator=(const WiFiUDP &other) = delete;
+
+private:
+    int fd;
+    sockaddr_in destination;
+    uint8_t packet[1500];
+    size_t length;
+};
@@ -0,0 +1,272 @@
+/* Copyright (c) 2025 Paul Winwood, G8KIG - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the GPL-Version 3 license.
+ *
+ * There is a copy of the GPL-Version 3 license in the same folder as this file.
+ */
+
+#include <errno.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <LittleFS.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+HardwareSerial Serial;
+WiFiClass WiFi;
+LittleFSClass LittleFS;
+
+static pthread_mutex_t logMutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Log lines from different threads are not interleaved
+int HardwareSerial::printf(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    pthread_mutex_lock(&logMutex);
+    int result = vfprintf(stdout, format, args);
+    fflush(stdout);
+    pthread_mutex_unlock(&logMutex);
+    va_end(args);
+    return result;
+}
+
+size_t HardwareSerial::print(const char *text)
+{
+    return printf("%s", text);
+}
+
+size_t HardwareSerial::println(const char *text)
+{
+    return printf("%s\n", text);
+}
+
+static uint64_t monotonicMicros()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000ULL + now.tv_nsec / 1000;
+}
+
+unsigned long millis()
+{
+    return (unsigned long)(monotonicMicros() / 1000);
+}
+
+unsigned long micros()
+{
+    return (unsigned long)monotonicMicros();
+}
+
+void delay(uint32_t ms)
+{
+    timespec interval = {(time_t)(ms / 1000), (long)(ms % 1000) * 1000000L};
+    while (nanosleep(&interval, &interval) != 0 && errno == EINTR)
+        ;
+}
+
+static SemaphoreHandle_t createSemaphore(StaticSemaphore_t *semaphore, int count)
+{
+    pthread_mutex_init(&semaphore->mutex, NULL);
+    pthread_condattr_t attributes;
+    pthread_condattr_init(&attributes);
+    pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+    pthread_cond_init(&semaphore->cond, &attributes);
+    pthread_condattr_destroy(&attributes);
+    semaphore->count = count;
+    return semaphore;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex()
+{
+    return createSemaphore(new StaticSemaphore_t, 1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t *buffer)
+{
+    return createSemaphore(buffer, 1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary()
+{
+    return createSemaphore(new StaticSemaphore_t, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t *buffer)
+{
+    return createSemaphore(buffer, 0);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks)
+{
+    timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += ticks / 1000;
+    deadline.tv_nsec += (long)(ticks % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L)
+    {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    pthread_mutex_lock(&semaphore->mutex);
+    while (semaphore->count == 0)
+    {
+        if (ticks == portMAX_DELAY)
+            pthread_cond_wait(&semaphore->cond, &semaphore->mutex);
+        else if (pthread_cond_timedwait(&semaphore->cond, &semaphore->mutex, &deadline) == ETIMEDOUT)
+            break;
+    }
+    BaseType_t result = pdFALSE;
+    if (semaphore->count > 0)
+    {
+        semaphore->count = 0;
+        result = pdTRUE;
+    }
+    pthread_mutex_unlock(&semaphore->mutex);
+    return result;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+    pthread_mutex_lock(&semaphore->mutex);
+    semaphore->count = 1;
+    pthread_cond_signal(&semaphore->cond);
+    pthread_mutex_unlock(&semaphore->mutex);
+    return pdTRUE;
+}
+
+bool IPAddress::fromString(const char *text)
+{
+    in_addr parsed;
+    if (inet_pton(AF_INET, text, &parsed) != 1)
+        return false;
+    address = parsed.s_addr;
+    return true;
+}
+
+int WiFiClass::hostByName(const char *host, IPAddress &result)
+{
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+
+    addrinfo *found = NULL;
+    if (getaddrinfo(host, NULL, &hints, &found) != 0 || found == NULL)
+        return 0;
+    result = IPAddress((uint32_t)((sockaddr_in *)found->ai_addr)->sin_addr.s_addr);
+    freeaddrinfo(found);
+    return 1;
+}
+
+WiFiUDP::WiFiUDP() : fd(-1), length(0)
+{
+    memset(&destination, 0, sizeof(destination));
+}
+
+WiFiUDP::~WiFiUDP()
+{
+    stop();
+}
+
+int WiFiUDP::beginPacket(IPAddress address, uint16_t port)
+{
+    if (fd < 0)
+    {
+        fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+            return 0;
+    }
+    destination.sin_family = AF_INET;
+    destination.sin_port = htons(port);
+    destination.sin_addr.s_addr = (uint32_t)address;
+    length = 0;
+    return 1;
+}
+
+size_t WiFiUDP::write(const uint8_t *data, size_t size)
+{
+    if (size > sizeof(packet) - length)
+        size = sizeof(packet) - length;
+    memcpy(packet + length, data, size);
+    length += size;
+    return size;
+}
+
+int WiFiUDP::endPacket()
+{
+    if (fd < 0)
+        return 0;
+    ssize_t sent = sendto(fd, packet, length, 0, (const sockaddr *)&destination, sizeof(destination));
+    length = 0;
+    return sent >= 0 ? 1 : 0;
+}
+
+void WiFiUDP::stop()
+{
+    if (fd >= 0)
+        close(fd);
+    fd = -1;
+}
+
+size_t File::write(const uint8_t *data, size_t size)
+{
+    return file != NULL ? fwrite(data, 1, size, file) : 0;
+}
+
+size_t File::read(uint8_t *data, size_t size)
+{
+    return file != NULL ? fread(data, 1, size, file) : 0;
+}
+
+size_t File::size()
+{
+    if (file == NULL)
+        return 0;
+    long position = ftell(file);
+    fseek(file, 0, SEEK_END);
+    long end = ftell(file);
+    fseek(file, position, SEEK_SET);
+    return end > 0 ? end : 0;
+}
+
+void File::flush()
+{
+    if (file != NULL)
+        fflush(file);
+}
+
+void File::close()
+{
+    if (file != NULL)
+        fclose(file);
+    file = NULL;
+}
+
+File LittleFSClass::open(const char *path, const char *mode)
+{
+    // "r", "w" or "a", and always binary
+    char hostMode[4];
+    snprintf(hostMode, sizeof(hostMode), "%cb", mode[0]);
+    return File(fopen(path, hostMode));
+}
+
+bool LittleFSClass::exists(const char *path)
+{
+    return access(path, F_OK) == 0;
+}
+
+bool LittleFSClass::remove(const char *path)
+{
+    return unlink(path) == 0;
+}
+
+bool LittleFSClass::rename(const char *from, const char *to)
+{
+    return ::rename(from, to) == 0;
+}
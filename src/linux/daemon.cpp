@@ -0,0 +1,655 @@
+/* Copyright (c) 2025 Paul Winwood, G8KIG - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the GPL-Version 3 license.
+ *
+ * There is a copy of the GPL-Version 3 license in the same folder as this file.
+ */
+
+// Linux build of the bridge. Frames arrive on a serial port or pty instead
+// of I2C, and everything is driven from one epoll loop; the sinks send from
+// their own thread as they do on the ESP32.
+
+#include <errno.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <LittleFS.h>
+
+#include "main.h"
+#include "LatencyHistogram.h"
+#include "workqueue.h"
+#include "SafeString.h"
+#include "FrameDecoder.h"
+#include "RecordStore.h"
+#include "Bands.h"
+#include "SpotHistory.h"
+#include "BandStats.h"
+#include "IngressFilter.h"
+#include "SpotSink.h"
+#include "PSKReporter.h"
+#include "ReporterSet.h"
+#include "WsjtxParser.h"
+#include "FrameCodec.h"
+#include "FrameTransport.h"
+#include "SerialTransport.h"
+#include "MockTransport.h"
+#include "LoadGenerator.h"
+#include "SoakTest.h"
+#include "HeapArena.h"
+#include "FrameCapture.h"
+#include "Replay.h"
+
+static const char *const PSK_REPORTER_HOSTNAME = "report.pskreporter.info";
+static const uint16_t PSK_REPORTER_PORT = 4739;
+static const uint16_t PSK_REPORTER_TEST_PORT = 14739;
+static const uint32_t SINK_POLL_MS = 500;
+static const uint32_t DRAIN_TIMEOUT_MS = 5000;
+static const uint32_t REOPEN_INTERVAL_S = 1;
+static const int MAX_EVENTS = 8;
+static const int MAX_DATAGRAMS_PER_POLL = 16;
+static const size_t WSJTX_DATAGRAM_SIZE = 1024;
+static const size_t SOAK_ARENA_SIZE = 1024 * 1024; // the record store here is much larger than on a board
+
+struct Options
+{
+    const char *device;
+    speed_t baud;
+    uint32_t flushSeconds;
+    uint16_t wsjtxPort; // 0 to not listen
+    size_t historyCapacity;
+    bool pskReporter;
+    bool testMode;
+    bool verbose;
+    uint32_t benchmarkFrames; // run the transport benchmark instead
+    uint32_t corruptEvery;
+    bool packedFrames; // benchmark spots with packed callsigns
+    uint16_t soakDays; // run the heap soak test instead
+    uint32_t stringRounds; // run the string building benchmark instead
+    uint16_t loadSlots;    // run the load generator for this many slots instead
+    const char *capturePath; // record the frames received here
+    const char *replayPath;  // replay this capture instead
+    double replaySpeed;
+};
+
+static Options options = {NULL, B115200, 300, 0, 20000, true, false, false, 0, 0, false, 0, 0, 0, NULL, NULL, 1.0};
+static SpotHistory spotHistory;
+static BandStats bandStats;
+static IngressFilter ingressFilter;
+static volatile bool sinksRunning = true;
+
+static ReporterSet &getReporters()
+{
+    static ReporterSet reporters;
+    static bool configured = false;
+    if (!configured)
+    {
+        reporters.begin((uint32_t)gethostid(), REPORT_BEST_SNR, &spotHistory, &bandStats, &ingressFilter);
+        configured = true;
+    }
+    return reporters;
+}
+
+// Processing functions - all called on the event loop thread
+void processTimeRequest(const RTCTime *pRtcTime)
+{
+    // the reply is made from the system clock, see timeReply()
+}
+
+void processSenderRecord(uint8_t receiver, const uint8_t *buffer, size_t length)
+{
+    PskReporter *reporter = getReporters().get(receiver);
+    if (reporter != NULL)
+        reporter->createSenderRecord(buffer, length);
+}
+
+void processSenderSoftwareRecord(uint8_t receiver, const uint8_t *buffer, size_t length)
+{
+    PskReporter *reporter = getReporters().get(receiver);
+    if (reporter != NULL)
+        reporter->createSenderSoftwareRecord(buffer, length);
+}
+
+void processReceiverRecord(uint8_t receiver, const uint8_t *buffer, size_t length)
+{
+    PskReporter *reporter = getReporters().get(receiver);
+    if (reporter != NULL)
+        reporter->addReceivedRecord(buffer, length);
+}
+
+void processPackedReceiverRecord(uint8_t receiver, const uint8_t *buffer, size_t length)
+{
+    PskReporter *reporter = getReporters().get(receiver);
+    if (reporter != NULL)
+        reporter->addPackedReceivedRecord(buffer, length);
+}
+
+void processSendRequest()
+{
+    getReporters().sendAll();
+}
+
+// Spots from WSJT-X on the network belong to the first receiver
+static bool addWsjtxSpot(const ReceivedRecordView &record, void *context)
+{
+    return getReporters().get(0)->addReceivedRecord(record);
+}
+
+// Every transport delivers frames here; only a time request wants a reply
+static bool onFrame(const uint8_t *frame, size_t length, void *context)
+{
+    captureFrame(frame, length);
+    handleReceivedFrame(frame, length);
+
+    // There is only the one thread, so the queue is emptied as each frame
+    // arrives rather than left to fill up behind a long read
+    while (processWorkQueue())
+        ;
+    return frameOperation(frame[0]) == OP_TIME_REQUEST;
+}
+
+// The time is read from the system clock when it is asked for
+static size_t timeReply(uint8_t *reply, size_t size, void *context)
+{
+    time_t now = time(NULL);
+    struct tm utc;
+    gmtime_r(&now, &utc);
+
+    RTCTime rtcTime;
+    rtcTime.seconds = utc.tm_sec;
+    rtcTime.minutes = utc.tm_min;
+    rtcTime.hours = utc.tm_hour;
+    rtcTime.dayOfWeek = utc.tm_wday;
+    rtcTime.day = utc.tm_mday;
+    rtcTime.month = utc.tm_mon + 1;
+    rtcTime.year = utc.tm_year + 1900 - 2000;
+
+    if (size < sizeof(rtcTime))
+        return 0;
+    memcpy(reply, &rtcTime, sizeof(rtcTime));
+    return sizeof(rtcTime);
+}
+
+static int openWsjtxSocket(uint16_t port)
+{
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return -1;
+
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(fd, (const sockaddr *)&address, sizeof(address)) != 0)
+    {
+        Serial.printf("Cannot listen for WSJT-X on port %u: %s\n", port, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    Serial.printf("Listening for WSJT-X on UDP port %u\n", port);
+    return fd;
+}
+
+static void handleWsjtxSocket(int fd, WsjtxParser &parser)
+{
+    static uint8_t datagram[WSJTX_DATAGRAM_SIZE];
+    for (int count = 0; count < MAX_DATAGRAMS_PER_POLL; ++count)
+    {
+        ssize_t length = recv(fd, datagram, sizeof(datagram), 0);
+        if (length <= 0)
+            break;
+        parser.handleDatagram(datagram, length, (uint32_t)time(NULL));
+    }
+}
+
+// A period of 0 fires once, a delay of 0 disarms the timer
+static void setTimer(int fd, uint32_t delaySeconds, uint32_t periodSeconds)
+{
+    itimerspec interval;
+    memset(&interval, 0, sizeof(interval));
+    interval.it_value.tv_sec = delaySeconds;
+    interval.it_interval.tv_sec = periodSeconds;
+    timerfd_settime(fd, 0, &interval, NULL);
+}
+
+static int createTimer()
+{
+    return timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+}
+
+static void watch(int epollFd, int fd)
+{
+    epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+}
+
+static void *sinkThread(void *parameter)
+{
+    while (sinksRunning)
+    {
+        if (!serviceSinks())
+            waitForSinkWork(SINK_POLL_MS);
+    }
+    return NULL;
+}
+
+// The load generator delivers its bursts from a thread of its own while
+// this one drains the queue, as the test task and main loop do on a board
+static volatile bool loadGeneratorRunning = false;
+
+struct LoadGeneratorRun
+{
+    LoadGeneratorConfig config;
+    LoadGeneratorReport report;
+};
+
+static void *loadGeneratorThread(void *parameter)
+{
+    LoadGeneratorRun *run = (LoadGeneratorRun *)parameter;
+    runLoadGenerator(run->config, run->report);
+    loadGeneratorRunning = false;
+    return NULL;
+}
+
+static void runLoadTest(uint16_t slots, double speed)
+{
+    static LoadGeneratorRun run;
+    run.config.slots = slots;
+    // flat out, each burst still takes its window but the next starts as
+    // soon as the queue has drained
+    if (speed > 0)
+    {
+        run.config.slotPeriodMs = (uint16_t)(run.config.slotPeriodMs / speed);
+        run.config.burstWindowMs = (uint16_t)(run.config.burstWindowMs / speed);
+    }
+    else
+    {
+        run.config.slotPeriodMs = 0;
+    }
+
+    loadGeneratorRunning = true;
+    pthread_t thread;
+    pthread_create(&thread, NULL, loadGeneratorThread, &run);
+    while (loadGeneratorRunning)
+    {
+        if (!processWorkQueue())
+            delay(1);
+    }
+    pthread_join(thread, NULL);
+    printLoadGeneratorReport(run.config, run.report);
+    printWorkQueueStats();
+}
+
+static void printStats(const SerialTransport &transport, const WsjtxParser &parser)
+{
+    transport.printStats();
+    printWorkQueueStats();
+    getReporters().printStats();
+    printSinkStats();
+    if (captureActive())
+        printCaptureStats();
+    const WsjtxStats &stats = parser.stats();
+    Serial.printf("WSJT-X: %u datagrams from %u clients, %u malformed, %u decodes, %u skipped, %u without status, %u spots accepted\n",
+                  stats.datagrams, stats.clients, stats.malformed, stats.decodes, stats.skipped, stats.noStatus, stats.accepted);
+    Serial.printf("Spot history %zu of %zu spots, %zu bytes\n", spotHistory.size(), spotHistory.capacity(), spotHistory.memoryUsed());
+
+    BandHourStats hour;
+    if (bandStats.hourStats(0, BAND_UNKNOWN, hour))
+    {
+        Serial.printf("This hour: %u spots, about %u callsigns", hour.spots, hour.unique);
+        for (uint8_t band = 0; band < BAND_COUNT; ++band)
+        {
+            if (bandStats.hourStats(0, band, hour) && hour.spots > 0)
+                Serial.printf(", %s %u/%u", bands[band].name, hour.spots, hour.unique);
+        }
+        Serial.printf("; last %u hours about %u callsigns\n", BAND_STATS_HOURS, bandStats.uniqueCallsigns(BAND_STATS_HOURS, BAND_UNKNOWN));
+    }
+}
+
+// host or host:port, a multicast group address is sent to once and not retried
+static bool addUdpSink(const char *spec, uint16_t defaultPort)
+{
+    static SafeString hosts[MAX_SINKS];
+    static char names[MAX_SINKS][16];
+    static int count = 0;
+    if (count >= MAX_SINKS)
+        return false;
+
+    const char *colon = strrchr(spec, ':');
+    uint16_t port = colon != NULL ? (uint16_t)atoi(colon + 1) : defaultPort;
+    hosts[count] = SafeString(spec, colon != NULL ? colon - spec : strlen(spec));
+    snprintf(names[count], sizeof(names[count]), "sink%d", count + 1);
+
+    IPAddress address;
+    UdpSink *sink;
+    if (address.fromString(hosts[count].c_str()))
+    {
+        bool multicast = IN_MULTICAST(ntohl((uint32_t)address));
+        sink = new UdpSink(names[count], NULL, address, port, multicast ? 1 : 3);
+    }
+    else
+    {
+        sink = new UdpSink(names[count], hosts[count].c_str(), IPAddress(), port);
+    }
+    Serial.printf("Sending reports to %s port %u\n", hosts[count].c_str(), port);
+    ++count;
+    return addSink(sink);
+}
+
+static speed_t baudRate(long rate)
+{
+    switch (rate)
+    {
+    case 9600:
+        return B9600;
+    case 19200:
+        return B19200;
+    case 38400:
+        return B38400;
+    case 57600:
+        return B57600;
+    case 230400:
+        return B230400;
+    case 460800:
+        return B460800;
+    case 921600:
+        return B921600;
+    default:
+        return B115200;
+    }
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s -d device [options]\n"
+            "  -d device   serial port or pty the transceiver writes frames to\n"
+            "  -b baud     serial speed, 115200 by default\n"
+            "  -s host[:port]  also send reports here, may be given %d times\n"
+            "  -n          do not send to PSK Reporter\n"
+            "  -t          send to the PSK Reporter test port\n"
+            "  -i seconds  report interval, 300 by default\n"
+            "  -w port     listen for WSJT-X and JTDX on this UDP port\n"
+            "  -H spots    spot history capacity, 20000 by default\n"
+            "  -v          log every work queue operation\n"
+            "  -B frames   benchmark the serial framing with this many frames and exit\n"
+            "  -e n        corrupt every nth frame of the benchmark\n"
+            "  -P          benchmark spots with packed callsigns\n"
+            "  -S days     soak test the heap with this many days of traffic and exit\n"
+            "  -F rounds   benchmark string formatting for this many rounds and exit\n"
+            "  -L slots    run the load generator for this many FT8 slots and exit\n"
+            "  -C file     capture the frames received to this file\n"
+            "  -R file     replay a capture through the bridge and exit\n"
+            "  -x speed    replay or load test this many times faster, 0 for flat out, 1 by default\n",
+            name, MAX_SINKS - 1);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *sinkSpecs[MAX_SINKS];
+    int sinkSpecCount = 0;
+
+    int option;
+    while ((option = getopt(argc, argv, "d:b:s:nti:w:H:vB:e:PS:F:L:C:R:x:")) != -1)
+    {
+        switch (option)
+        {
+        case 'd':
+            options.device = optarg;
+            break;
+        case 'b':
+            options.baud = baudRate(atol(optarg));
+            break;
+        case 's':
+            if (sinkSpecCount < MAX_SINKS - 1)
+                sinkSpecs[sinkSpecCount++] = optarg;
+            break;
+        case 'n':
+            options.pskReporter = false;
+            break;
+        case 't':
+            options.testMode = true;
+            break;
+        case 'i':
+            options.flushSeconds = atol(optarg) > 0 ? atol(optarg) : 1;
+            break;
+        case 'w':
+            options.wsjtxPort = (uint16_t)atoi(optarg);
+            break;
+        case 'H':
+            options.historyCapacity = atol(optarg);
+            break;
+        case 'v':
+            options.verbose = true;
+            break;
+        case 'B':
+            options.benchmarkFrames = atol(optarg);
+            break;
+        case 'e':
+            options.corruptEvery = atol(optarg);
+            break;
+        case 'P':
+            options.packedFrames = true;
+            break;
+        case 'S':
+            options.soakDays = (uint16_t)atoi(optarg);
+            break;
+        case 'F':
+            options.stringRounds = atol(optarg);
+            break;
+        case 'L':
+            options.loadSlots = (uint16_t)atoi(optarg);
+            break;
+        case 'C':
+            options.capturePath = optarg;
+            break;
+        case 'R':
+            options.replayPath = optarg;
+            break;
+        case 'x':
+            options.replaySpeed = atof(optarg);
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (options.stringRounds > 0)
+    {
+        benchmarkStringBuilding(options.stringRounds);
+        return 0;
+    }
+    if (options.device == NULL && options.benchmarkFrames == 0 && options.soakDays == 0 && options.loadSlots == 0 &&
+        options.replayPath == NULL)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    // signals are read from the event loop, so no thread may take them
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGUSR1);
+    sigaddset(&signals, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+    Serial.println("WifiTimeSync daemon started");
+    initialiseWorkQueue();
+    setWorkQueueLogging(options.verbose);
+    setIngressFilter(&ingressFilter);
+    initialiseSinks();
+    if (options.pskReporter)
+    {
+        static UdpSink pskReporterSink("pskreporter", PSK_REPORTER_HOSTNAME, IPAddress(74, 116, 41, 13),
+                                       options.testMode ? PSK_REPORTER_TEST_PORT : PSK_REPORTER_PORT);
+        addSink(&pskReporterSink);
+    }
+    for (int i = 0; i < sinkSpecCount; ++i)
+        addUdpSink(sinkSpecs[i], PSK_REPORTER_PORT);
+    if (!spotHistory.begin(options.historyCapacity))
+        Serial.println("Failed to allocate the spot history");
+    Serial.printf("%d receivers, record stores hold %d stations each, %d datagram buffers\n",
+                  MAX_RECEIVERS, PSK_MAX_RECORDS, DATAGRAM_POOL_SIZE);
+
+    static WsjtxParser wsjtxParser(addWsjtxSpot, NULL);
+
+    if (options.benchmarkFrames > 0)
+    {
+        TransportBenchmarkConfig config = {options.benchmarkFrames, 256, options.corruptEvery, 50, options.packedFrames};
+        runTransportBenchmark(config, onFrame, timeReply, NULL);
+        printWorkQueueStats();
+        return 0;
+    }
+
+    if (options.soakDays > 0)
+    {
+        if (!heapArenaBegin(SOAK_ARENA_SIZE))
+            return 1;
+        SoakConfig config;
+        config.days = options.soakDays;
+        SoakReport report;
+        bool passed = runSoakTest(config, report);
+        heapArenaEnd();
+        printSoakReport(config, report);
+        return passed ? 0 : 1;
+    }
+
+    if (options.loadSlots > 0)
+    {
+        runLoadTest(options.loadSlots, options.replaySpeed);
+        return 0;
+    }
+
+    if (options.replayPath != NULL)
+    {
+        ReplayConfig config;
+        config.path = options.replayPath;
+        config.speed = options.replaySpeed;
+        static ReplayReport report;
+        bool replayed = runReplay(config, getReporters(), report);
+        if (replayed)
+            printReplayReport(config, report);
+        return replayed ? 0 : 1;
+    }
+
+    if (options.capturePath != NULL && !beginCapture(options.capturePath))
+        return 1;
+
+    pthread_t sinkThreadHandle;
+    pthread_create(&sinkThreadHandle, NULL, sinkThread, NULL);
+
+    int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    int signalFd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    int flushTimer = createTimer();
+    int reopenTimer = createTimer();
+    setTimer(flushTimer, options.flushSeconds, options.flushSeconds);
+    int wsjtxFd = options.wsjtxPort != 0 ? openWsjtxSocket(options.wsjtxPort) : -1;
+    watch(epollFd, signalFd);
+    watch(epollFd, flushTimer);
+    watch(epollFd, reopenTimer);
+    if (wsjtxFd >= 0)
+        watch(epollFd, wsjtxFd);
+
+    static SerialTransport transport(options.device, options.baud);
+    transport.setHandlers(onFrame, timeReply, NULL);
+    if (transport.begin())
+        watch(epollFd, transport.fd());
+    else
+        setTimer(reopenTimer, REOPEN_INTERVAL_S, 0);
+
+    bool running = true;
+    while (running)
+    {
+        epoll_event events[MAX_EVENTS];
+        int count = epoll_wait(epollFd, events, MAX_EVENTS, -1);
+        if (count < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            Serial.printf("epoll_wait: %s\n", strerror(errno));
+            break;
+        }
+
+        for (int i = 0; i < count; ++i)
+        {
+            int fd = events[i].data.fd;
+            if (fd == transport.fd())
+            {
+                transport.poll();
+                if (transport.fd() < 0)
+                    setTimer(reopenTimer, REOPEN_INTERVAL_S, 0);
+            }
+            else if (fd == wsjtxFd)
+            {
+                handleWsjtxSocket(wsjtxFd, wsjtxParser);
+            }
+            else if (fd == flushTimer || fd == reopenTimer)
+            {
+                uint64_t expirations;
+                if (read(fd, &expirations, sizeof(expirations)) != sizeof(expirations))
+                    continue;
+                if (fd == flushTimer)
+                {
+                    printStats(transport, wsjtxParser);
+                    addWorkQueueItem(OP_SEND_REQUEST, NULL, 0);
+                }
+                else if (transport.fd() < 0)
+                {
+                    if (transport.begin())
+                    {
+                        watch(epollFd, transport.fd());
+                    }
+                    else
+                    {
+                        setTimer(reopenTimer, REOPEN_INTERVAL_S, 0);
+                    }
+                }
+            }
+            else if (fd == signalFd)
+            {
+                signalfd_siginfo info;
+                while (read(signalFd, &info, sizeof(info)) == sizeof(info))
+                {
+                    if (info.ssi_signo == SIGUSR1)
+                        printStats(transport, wsjtxParser);
+                    else if (info.ssi_signo != SIGPIPE)
+                        running = false;
+                }
+            }
+        }
+
+        while (processWorkQueue())
+            ;
+        flushCapture();
+    }
+
+    // report what is still held, and give the sinks a moment to send it
+    Serial.println("Stopping");
+    endCapture();
+    getReporters().sendAll();
+    unsigned long started = millis();
+    while (!sinksIdle() && millis() - started < DRAIN_TIMEOUT_MS)
+        delay(50);
+    sinksRunning = false;
+    pthread_join(sinkThreadHandle, NULL);
+    printStats(transport, wsjtxParser);
+    return 0;
+}
@@ -6,38 +6,132 @@
  */
 
 #include <WiFi.h>
-#include <WiFiManager.h>
-#include <NTPClient.h>
 #include <ESP32Time.h>
 #include <HardwareSerial.h>
-#include <Wire.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
+#include <freertos/timers.h>
 #include <esp_wifi.h>
+#include <esp_freertos_hooks.h>
+#include <LittleFS.h>
 
 #include "main.h"
+#include "crc.h"
+#include "LatencyHistogram.h"
 #include "workqueue.h"
 #include "SafeString.h"
+#include "FrameDecoder.h"
+#include "RecordStore.h"
+#include "Bands.h"
+#include "SpotHistory.h"
+#include "BandStats.h"
+#include "IngressFilter.h"
+#include "StatusServer.h"
+#include "SpotSink.h"
 #include "PSKReporter.h"
+#include "ReporterSet.h"
+#include "NetworkService.h"
+#include "FrameCodec.h"
+#include "FrameTransport.h"
+#include "I2CTransport.h"
+#include "UartTransport.h"
+#include "WsjtxParser.h"
+#include "WsjtxListener.h"
+#include "LoadGenerator.h"
+#include "SoakTest.h"
+#include "FrameCapture.h"
+
+#ifndef NETWORK_TASK_STACK_SIZE
+#define NETWORK_TASK_STACK_SIZE 16384 // the configuration portal needs most of it
+#endif
+#ifndef SPOT_HISTORY_CAPACITY
+#define SPOT_HISTORY_CAPACITY 2000 // internal RAM
+#endif
+#ifndef SPOT_HISTORY_PSRAM_CAPACITY
+#define SPOT_HISTORY_PSRAM_CAPACITY 20000
+#endif
+#ifndef WSJTX_TASK_STACK_SIZE
+#define WSJTX_TASK_STACK_SIZE 3072
+#endif
+#ifndef LOOP_POLL_MS
+#define LOOP_POLL_MS 200 // the status server and serial commands are polled this often
+#endif
 
 static const uint8_t RTC_I2C_ADDRESS = 0x2A;
+#ifdef TRANSPORT_UART
+static UartTransport transport(Serial1, UART_BAUD, UART_RX_PIN, UART_TX_PIN);
+#else
+static I2CTransport transport(RTC_I2C_ADDRESS);
+#endif
+static const char *const PSK_REPORTER_HOSTNAME = "report.pskreporter.info";
+static const uint16_t PSK_REPORTER_PORT = 4739;
+static const uint16_t PSK_REPORTER_TEST_PORT = 14739;
+static const uint32_t SINK_POLL_MS = 500;
 static const uint8_t BUTTON_PIN_C3 = 9;
 static const uint8_t BUTTON_PIN_S2 = 0;
-static TaskHandle_t timeTaskHandle = 0;
-static TaskHandle_t wifiTaskHandle = 0;
+static TaskHandle_t networkTaskHandle = 0;
+static TaskHandle_t wsjtxTaskHandle = 0;
 static RTCTime rtcTime = {0};
 static ESP32Time rtc(0);
 static volatile bool timeIsValid = false;
 static uint32_t sequenceNumber = 0;
+static SpotHistory spotHistory;
+static BandStats bandStats;
+static IngressFilter ingressFilter;
+static unsigned long bootToTransportReadyMs = 0;
+
+// The loop sleeps until one of these is signalled, or LOOP_POLL_MS passes
+enum LoopEvent
+{
+    LOOP_EVENT_WORK = 1 << 0,      // an item was queued
+    LOOP_EVENT_TRANSPORT = 1 << 1, // bytes are waiting for transport.poll()
+    LOOP_EVENT_CLOCK = 1 << 2,     // every half second, refresh the time reply
+    LOOP_EVENT_REPORT = 1 << 3,    // every five minutes, flush the reports
+    LOOP_EVENT_WSJTX = 1 << 4      // datagrams are waiting for handleWsjtxListener()
+};
+static const int LOOP_EVENT_COUNT = 5;
+static const char *const loopEventNames[LOOP_EVENT_COUNT] = {"work", "transport", "clock", "report", "wsjtx"};
+
+struct LoopActivity
+{
+    uint32_t wakeups;
+    uint32_t events[LOOP_EVENT_COUNT];
+    uint32_t timeouts; // woken only to poll
+    uint64_t busyMicros;
+    uint32_t idleCalls; // idle hook calls, about one per tick the CPU was idle
+    unsigned long sinceMs;
+    TickType_t sinceTick;
+};
+
+static TaskHandle_t loopTaskHandle = 0;
+static TimerHandle_t clockTimer = 0;
+static TimerHandle_t reportTimer = 0;
+static LoopActivity loopActivity;
+static volatile uint32_t idleCalls = 0;
+
+#ifdef STATIC_ALLOCATION
+static StackType_t networkTaskStack[NETWORK_TASK_STACK_SIZE];
+static StaticTask_t networkTaskBuffer;
+static StackType_t wsjtxTaskStack[WSJTX_TASK_STACK_SIZE];
+static StaticTask_t wsjtxTaskBuffer;
+static StaticTimer_t clockTimerBuffer;
+static StaticTimer_t reportTimerBuffer;
+#endif
 
 // forward references
-static void TimeTask(void *parameter);
-static void WiFiTask(void *parameter);
-static void WiFiProcessing();
+static void NetworkTask(void *parameter);
+static void WsjtxTask(void *parameter);
+static void reportMemoryBudget();
+static void processSerialCommands();
+static void printLoopActivity();
 
 #ifdef TESTING
+static const uint32_t TEST_TASK_STACK_SIZE = 8192;
 static TaskHandle_t testTaskHandle = 0;
 static void TestTask(void *parameter);
+static void SoakTask(void *parameter);
+static void startTestTask(TaskFunction_t task, const char *name);
+static void benchmarkCrc();
 static const bool testMode = true;
 static int8_t lastStateC3 = HIGH;
 static int8_t lastStateS2 = HIGH;
@@ -45,82 +139,88 @@ static bool testTaskRunning = false;
 #else
 static const bool testMode = false;
 #endif
+static const ReportStatistic reportStatistic = REPORT_BEST_SNR;
 
-// I2C slave API
-static void receiveEvent(int length)
+// From any task or timer, never from an interrupt
+static void signalLoop(uint32_t events)
 {
-    if (length > 0 && Wire.available() > 0)
-    {
-        uint8_t buffer[31] = {0};
-        int idx = 0;
-        uint8_t operation = Wire.read();
-        switch (operation)
-        {
-        case OP_TIME_REQUEST:
-            // Nothing to do - see request event
-            return;
-
-        case OP_SENDER_RECORD:
-            for (idx = 0; Wire.available() && (idx < sizeof(buffer)); ++idx)
-            {
-                buffer[idx] = Wire.read();
-            }
-            if (idx > 0)
-                addWorkQueueItem(OP_SENDER_RECORD, buffer, idx);
-            break;
+    if (loopTaskHandle != 0)
+        xTaskNotify(loopTaskHandle, events, eSetBits);
+}
 
-        case OP_SENDER_SOFTWARE_RECORD:
-            for (idx = 0; Wire.available() && (idx < sizeof(buffer)); ++idx)
-            {
-                buffer[idx] = Wire.read();
-            }
-            if (idx > 0)
-                addWorkQueueItem(OP_SENDER_SOFTWARE_RECORD, buffer, idx);
-            break;
+static void signalWork()
+{
+    signalLoop(LOOP_EVENT_WORK);
+}
 
-        case OP_RECEIVER_RECORD:
-            for (idx = 0; Wire.available() && (idx < sizeof(buffer)); ++idx)
-            {
-                buffer[idx] = Wire.read();
-            }
-            if (idx > 0)
-                addWorkQueueItem(OP_RECEIVER_RECORD, buffer, idx);
-            break;
+static void signalTransport()
+{
+    signalLoop(LOOP_EVENT_TRANSPORT);
+}
 
-        case OP_SEND_REQUEST:
-            addWorkQueueItem(OP_SEND_REQUEST, NULL, 0);
-            break;
-        }
-        while (Wire.available())
-            Wire.read();
-    }
+static void signalWsjtx()
+{
+    signalLoop(LOOP_EVENT_WSJTX);
 }
 
-// I2C slave API
-static void requestEvent()
+// Each timer's id is the event it signals
+static void onLoopTimer(TimerHandle_t timer)
 {
-    Wire.write((const uint8_t *)&rtcTime, sizeof(rtcTime));
+    signalLoop((uint32_t)(uintptr_t)pvTimerGetTimerID(timer));
 }
 
-// Processing functions - all called on the main thread
-void processTimeRequest(const RTCTime *pRtcTime)
+// Runs from the idle task, once per interrupt while the CPU has nothing to do
+static bool countIdle()
 {
-    memcpy(&rtcTime, pRtcTime, sizeof(rtcTime));
+    ++idleCalls;
+    return true;
 }
 
-static uint32_t crc32(uint8_t *message, size_t messageSize)
+static void resetLoopActivity()
 {
-    uint32_t crc = 0xFFFFFFFF;
-    for (size_t idx = 0; idx < messageSize; ++idx)
-    {
-        crc ^= message[idx];
-        for (int j = 7; j >= 0; j--)
-        {
-            uint32_t mask = -(crc & 1);
-            crc = (crc >> 1) ^ (0xEDB88320 & mask);
-        }
-    }
-    return ~crc;
+    memset(&loopActivity, 0, sizeof(loopActivity));
+    loopActivity.idleCalls = idleCalls;
+    loopActivity.sinceMs = millis();
+    loopActivity.sinceTick = xTaskGetTickCount();
+}
+
+// Wake-ups since the last report and why, the share of the time the loop
+// was busy and roughly how much the CPU was idle
+static void printLoopActivity()
+{
+    unsigned long elapsedMs = millis() - loopActivity.sinceMs;
+    TickType_t ticks = xTaskGetTickCount() - loopActivity.sinceTick;
+    uint32_t idle = idleCalls - loopActivity.idleCalls;
+    if (elapsedMs == 0 || ticks == 0)
+        return;
+    Serial.printf("Loop: %.1f wake-ups/s (", loopActivity.wakeups * 1000.0f / elapsedMs);
+    for (int event = 0; event < LOOP_EVENT_COUNT; ++event)
+        Serial.printf("%s %u, ", loopEventNames[event], loopActivity.events[event]);
+    Serial.printf("poll %u), busy %.2f%%, CPU idle about %u%%\n", loopActivity.timeouts,
+                  loopActivity.busyMicros / (elapsedMs * 10.0f), idle < ticks ? idle * 100 / ticks : 100);
+    resetLoopActivity();
+}
+
+// Every transport delivers frames here; only a time request wants a reply
+static bool onFrame(const uint8_t *frame, size_t length, void *context)
+{
+    captureFrame(frame, length);
+    handleReceivedFrame(frame, length);
+    return frameOperation(frame[0]) == OP_TIME_REQUEST;
+}
+
+static size_t timeReply(uint8_t *reply, size_t size, void *context)
+{
+    if (size < sizeof(rtcTime))
+        return 0;
+    memcpy(reply, &rtcTime, sizeof(rtcTime));
+    return sizeof(rtcTime);
+}
+
+// Processing functions - all called on the main thread
+void processTimeRequest(const RTCTime *pRtcTime)
+{
+    memcpy(&rtcTime, pRtcTime, sizeof(rtcTime));
 }
 
 static uint32_t readMacAddress()
@@ -133,34 +233,194 @@ static uint32_t readMacAddress()
     return 0;
 }
 
-static PskReporter &getPskReporter()
+static ReporterSet &getReporters()
 {
-    static PskReporter pskReporter(readMacAddress(), testMode);
-    return pskReporter;
+    static ReporterSet reporters;
+    static bool configured = false;
+    if (!configured)
+    {
+        reporters.begin(readMacAddress(), reportStatistic, &spotHistory, &bandStats, &ingressFilter);
+        configured = true;
+    }
+    return reporters;
 }
 
-void processSenderRecord(const uint8_t *buffer)
+void processSenderRecord(uint8_t receiver, const uint8_t *buffer, size_t length)
 {
-    getPskReporter().createSenderRecord(buffer);
+    PskReporter *reporter = getReporters().get(receiver);
+    if (reporter != NULL)
+        reporter->createSenderRecord(buffer, length);
 }
 
-void processSenderSoftwareRecord(const uint8_t *buffer)
+void processSenderSoftwareRecord(uint8_t receiver, const uint8_t *buffer, size_t length)
 {
-    getPskReporter().createSenderSoftwareRecord(buffer);
+    PskReporter *reporter = getReporters().get(receiver);
+    if (reporter != NULL)
+        reporter->createSenderSoftwareRecord(buffer, length);
 }
 
-void processReceiverRecord(const uint8_t *buffer)
+void processReceiverRecord(uint8_t receiver, const uint8_t *buffer, size_t length)
 {
-    getPskReporter().addReceivedRecord(buffer);
+    PskReporter *reporter = getReporters().get(receiver);
+    if (reporter != NULL)
+        reporter->addReceivedRecord(buffer, length);
+}
+
+void processPackedReceiverRecord(uint8_t receiver, const uint8_t *buffer, size_t length)
+{
+    PskReporter *reporter = getReporters().get(receiver);
+    if (reporter != NULL)
+        reporter->addPackedReceivedRecord(buffer, length);
+}
+
+// Spots from WSJT-X on the network belong to the first receiver
+static bool addWsjtxSpot(const ReceivedRecordView &record, void *context)
+{
+    return getReporters().get(0)->addReceivedRecord(record);
 }
 
 void processSendRequest()
 {
-    getPskReporter().send();
+    getReporters().sendAll();
+}
+
+// Every flush goes to PSK Reporter, and to the aggregator and multicast
+// group when they are configured
+static void addSinks()
+{
+    static UdpSink pskReporterSink("pskreporter", PSK_REPORTER_HOSTNAME, IPAddress(74, 116, 41, 13),
+                                   testMode ? PSK_REPORTER_TEST_PORT : PSK_REPORTER_PORT);
+    addSink(&pskReporterSink);
+
+#ifdef AGGREGATOR_HOST
+#ifndef AGGREGATOR_PORT
+#define AGGREGATOR_PORT PSK_REPORTER_PORT
+#endif
+    static UdpSink aggregatorSink("aggregator", AGGREGATOR_HOST, IPAddress(), AGGREGATOR_PORT);
+    addSink(&aggregatorSink);
+#endif
+
+#ifdef SPOT_MULTICAST_GROUP
+#ifndef SPOT_MULTICAST_PORT
+#define SPOT_MULTICAST_PORT PSK_REPORTER_PORT
+#endif
+    // a group address is never looked up, and nobody acknowledges it, so
+    // one attempt is enough
+    IPAddress group;
+    group.fromString(SPOT_MULTICAST_GROUP);
+    static UdpSink multicastSink("multicast", NULL, group, SPOT_MULTICAST_PORT, 1);
+    addSink(&multicastSink);
+#endif
+}
+
+static void reportTaskStack(const char *name, TaskHandle_t handle, uint32_t stackSize)
+{
+    if (handle != 0)
+    {
+        // ESP-IDF reports the high water mark in bytes
+        uint32_t unused = uxTaskGetStackHighWaterMark(handle);
+        Serial.printf("  %-10s stack %6u, peak use %6u, never used %6u\n",
+                      name, stackSize, stackSize - unused, unused);
+    }
+}
+
+// Stack high water marks and heap low water mark, to size the stacks and
+// the record store against what is actually used
+static void reportMemoryBudget()
+{
+    Serial.println("Memory budget:");
+    reportTaskStack("loopTask", xTaskGetCurrentTaskHandle(), getArduinoLoopTaskStackSize());
+    reportTaskStack("NetworkTask", networkTaskHandle, NETWORK_TASK_STACK_SIZE);
+    reportTaskStack("WsjtxTask", wsjtxTaskHandle, WSJTX_TASK_STACK_SIZE);
+#ifdef TESTING
+    reportTaskStack("TestTask", testTaskRunning ? testTaskHandle : 0, TEST_TASK_STACK_SIZE);
+#endif
+    Serial.printf("  boot to %s ready %lu ms, boot to connected %lu ms\n", transport.name(), bootToTransportReadyMs, networkStats().connectedAfterBootMs);
+    Serial.printf("  heap %u, free %u, minimum ever free %u, largest block %u\n",
+                  ESP.getHeapSize(), ESP.getFreeHeap(), ESP.getMinFreeHeap(), ESP.getMaxAllocHeap());
+    Serial.printf("  reporters %u x %u bytes (%u records of %u, %u with the index), work queue %u bytes, sinks %u bytes\n",
+                  MAX_RECEIVERS, sizeof(PskReporter), PSK_MAX_RECORDS, sizeof(ReceivedRecord),
+                  sizeof(RecordStore) / PSK_MAX_RECORDS, getWorkQueueFootprint(), getSinkFootprint());
+    Serial.printf("  spot history %u of %u spots, %u bytes in %s\n",
+                  spotHistory.size(), spotHistory.capacity(), spotHistory.memoryUsed(),
+                  spotHistory.inPsram() ? "PSRAM" : "RAM");
+    Serial.printf("  band statistics %u bytes for %u hours, frame capture ring %u bytes\n",
+                  sizeof(BandStats), BAND_STATS_HOURS, CAPTURE_RING_SIZE);
+#ifdef STATIC_ALLOCATION
+    Serial.printf("  static task stack %u bytes\n", sizeof(networkTaskStack));
+#endif
+}
+
+// Single character commands typed on the serial monitor
+static void processSerialCommands()
+{
+    while (Serial.available() > 0)
+    {
+        switch (Serial.read())
+        {
+        case 'l':
+            printLoopActivity();
+            break;
+        case 'm':
+            reportMemoryBudget();
+            break;
+        case 'n':
+            printNetworkStats();
+            break;
+        case 'q':
+            printWorkQueueStats();
+            getReporters().printStats();
+            break;
+        case 's':
+            printSinkStats();
+            break;
+        case 't':
+            transport.printStats();
+            break;
+        case 'w':
+            requestNetworkScan();
+            break;
+        case 'x':
+            printWsjtxStats();
+            break;
+        case 'r':
+            if (captureActive())
+                endCapture();
+            else
+                beginCapture(CAPTURE_PATH);
+            break;
+#ifdef TESTING
+        case 'c':
+            benchmarkCrc();
+            break;
+        case 'f':
+            benchmarkStringBuilding(2000);
+            break;
+        case 'k':
+            startTestTask(SoakTask, "SoakTask");
+            break;
+#endif
+        }
+    }
 }
 
 #ifdef TESTING
-static void startTestTask()
+// What checking a frame's CRC costs, for a typical spot
+static void benchmarkCrc()
+{
+    static const int ROUNDS = 10000;
+    uint8_t frame[MAX_FRAME_SIZE];
+    frame[0] = OP_RECEIVER_RECORD;
+    size_t length = 1 + encodeReceivedRecord(frame + 1, sizeof(frame) - 1, "DL3ABC", 14075123, (uint8_t)-12);
+    volatile uint32_t result = 0;
+    unsigned long started = micros();
+    for (int round = 0; round < ROUNDS; ++round)
+        result = result ^ crc32(frame, length);
+    unsigned long elapsed = micros() - started;
+    Serial.printf("CRC-32 of a %u byte frame: %.0f ns\n", length, elapsed * 1000.0f / ROUNDS);
+}
+
+static void startTestTask(TaskFunction_t task, const char *name)
 {
     if (testTaskRunning)
     {
@@ -168,299 +428,213 @@ static void startTestTask()
     }
     else
     {
-        xTaskCreate(TestTask, "TestTask", 8192, NULL, 1, &testTaskHandle);
+        xTaskCreate(task, name, TEST_TASK_STACK_SIZE, NULL, 1, &testTaskHandle);
     }
 }
 #endif
 
+// From the network task, with each NTP update
+static void setClock(uint32_t epochSeconds, uint16_t milliseconds)
+{
+    timeIsValid = false;
+    // ESP32Time passes its "ms" argument straight to tv_usec
+    rtc.setTime(epochSeconds, milliseconds * 1000);
+    timeIsValid = true;
+    Serial.print("Time updated: ");
+    Serial.println(rtc.getDateTime(true));
+}
+
 void setup()
 {
     Serial.begin(115200);
-#ifdef TESTIING
+#ifdef TESTING
     pinMode(BUTTON_PIN_C3, INPUT_PULLUP);
     pinMode(BUTTON_PIN_S2, INPUT_PULLUP);
 #endif
 
+    Serial.println("WifiTimeSync started");
+    loopTaskHandle = xTaskGetCurrentTaskHandle();
+    initialiseWorkQueue();
+    setWorkQueueSignal(signalWork);
+    setIngressFilter(&ingressFilter);
+    initialiseSinks();
+    addSinks();
+    if (!spotHistory.begin(psramFound() ? SPOT_HISTORY_PSRAM_CAPACITY : SPOT_HISTORY_CAPACITY))
+        Serial.println("Failed to allocate the spot history");
+    beginStatusServer(&spotHistory, &bandStats);
+    beginWsjtxListener(addWsjtxSpot, NULL, signalWsjtx);
+
+    // The transceiver can queue spots and ask for the time before there is
+    // a network, so the transport comes up first
+    transport.setHandlers(onFrame, timeReply, NULL);
+    transport.setWakeup(signalTransport);
+    if (!transport.begin())
+        Serial.printf("Failed to start the %s transport\n", transport.name());
+    bootToTransportReadyMs = millis();
+    Serial.printf("%s ready %lu ms after boot\n", transport.name(), bootToTransportReadyMs);
+
     WiFi.mode(WIFI_STA);
     WiFi.setTxPower(WIFI_POWER_18_5dBm);
     WiFi.disconnect();
 
-    Serial.println("WifiTimeSync started");
-    initialiseWorkQueue();
+    beginNetworkService(setClock);
+#ifdef STATIC_ALLOCATION
+    networkTaskHandle = xTaskCreateStatic(NetworkTask, "NetworkTask", NETWORK_TASK_STACK_SIZE, NULL, 1, networkTaskStack, &networkTaskBuffer);
+#else
+    xTaskCreate(NetworkTask, "NetworkTask", NETWORK_TASK_STACK_SIZE, NULL, 1, &networkTaskHandle);
+#endif
+#ifdef STATIC_ALLOCATION
+    wsjtxTaskHandle = xTaskCreateStatic(WsjtxTask, "WsjtxTask", WSJTX_TASK_STACK_SIZE, NULL, 1, wsjtxTaskStack, &wsjtxTaskBuffer);
+#else
+    xTaskCreate(WsjtxTask, "WsjtxTask", WSJTX_TASK_STACK_SIZE, NULL, 1, &wsjtxTaskHandle);
+#endif
 
-    WiFiProcessing();
-    xTaskCreate(WiFiTask, "WiFiTask", 16384, NULL, 1, &wifiTaskHandle);
-    xTaskCreate(TimeTask, "TimeTask", 16384, NULL, 1, &timeTaskHandle);
+    // periodic work is signalled to the loop rather than done in the timer
+    // task, which has a small stack
+#ifdef STATIC_ALLOCATION
+    clockTimer = xTimerCreateStatic("clock", pdMS_TO_TICKS(500), pdTRUE, (void *)(uintptr_t)LOOP_EVENT_CLOCK, onLoopTimer, &clockTimerBuffer);
+    reportTimer = xTimerCreateStatic("report", pdMS_TO_TICKS(5 * 60 * 1000), pdTRUE, (void *)(uintptr_t)LOOP_EVENT_REPORT, onLoopTimer, &reportTimerBuffer);
+#else
+    clockTimer = xTimerCreate("clock", pdMS_TO_TICKS(500), pdTRUE, (void *)(uintptr_t)LOOP_EVENT_CLOCK, onLoopTimer);
+    reportTimer = xTimerCreate("report", pdMS_TO_TICKS(5 * 60 * 1000), pdTRUE, (void *)(uintptr_t)LOOP_EVENT_REPORT, onLoopTimer);
+#endif
+    xTimerStart(clockTimer, 0);
+    xTimerStart(reportTimer, 0);
+    esp_register_freertos_idle_hook_for_cpu(countIdle, xPortGetCoreID());
+    resetLoopActivity();
 
-    Wire.begin(RTC_I2C_ADDRESS);
-    Wire.onReceive(receiveEvent);
-    Wire.onRequest(requestEvent);
+    reportMemoryBudget();
 }
 
-void loop()
+static void updateTimeReply()
 {
-    static unsigned long halfSecondCall = 0;
-    static unsigned long fiveMinuteCall = 0;
-    unsigned long now = millis();
+    if (timeIsValid)
+    {
+        rtcTime.seconds = rtc.getSecond();
+        rtcTime.minutes = rtc.getMinute();
+        rtcTime.hours = rtc.getHour(true);
+        rtcTime.dayOfWeek = rtc.getDayofWeek();
+        rtcTime.day = rtc.getDay();
+        rtcTime.month = rtc.getMonth() + 1;
+        rtcTime.year = rtc.getYear() - 2000;
+    }
+    else
+    {
+        memset(&rtcTime, 0, sizeof(rtcTime));
+    }
+}
 
-    if (now - halfSecondCall >= 500) // 1/2 second
+// Sleeps until there is something to do. Queued work, received bytes and
+// WSJT-X datagrams wake it straight away, the timers wake it for the
+// periodic work, and it wakes every LOOP_POLL_MS anyway for the status
+// server and serial commands, which can only be polled.
+void loop()
+{
+    uint32_t events = 0;
+    xTaskNotifyWait(0, UINT32_MAX, &events, pdMS_TO_TICKS(LOOP_POLL_MS));
+    unsigned long woke = micros();
+
+    ++loopActivity.wakeups;
+    if (events == 0)
+        ++loopActivity.timeouts;
+    for (int event = 0; event < LOOP_EVENT_COUNT; ++event)
     {
-        halfSecondCall = now;
-        if (timeIsValid)
-        {
-            rtcTime.seconds = rtc.getSecond();
-            rtcTime.minutes = rtc.getMinute();
-            rtcTime.hours = rtc.getHour(true);
-            rtcTime.dayOfWeek = rtc.getDayofWeek();
-            rtcTime.day = rtc.getDay();
-            rtcTime.month = rtc.getMonth() + 1;
-            rtcTime.year = rtc.getYear() - 2000;
-        }
-        else
-        {
-            memset(&rtcTime, 0, sizeof(rtcTime));
-        }
+        if (events & (1 << event))
+            ++loopActivity.events[event];
     }
 
-    if (now - fiveMinuteCall >= 5 * 60 * 1000) // 5 minutes
+    if (events & LOOP_EVENT_CLOCK)
+        updateTimeReply();
+
+    if (events & LOOP_EVENT_REPORT)
     {
-        fiveMinuteCall = now;
+        printWorkQueueStats();
+        getReporters().printStats();
+        printSinkStats();
+        printLoopActivity();
+        if (captureActive())
+            printCaptureStats();
         addWorkQueueItem(OP_SEND_REQUEST, NULL, 0);
     }
 
-    processWorkQueue();
+    transport.poll();
+    while (processWorkQueue())
+        ;
+    flushCapture();
+    processSerialCommands();
+    handleStatusServer();
+    if (events & LOOP_EVENT_WSJTX)
+        handleWsjtxListener();
 
 #ifdef TESTING
     // debugging
     int8_t currentStateC3 = digitalRead(BUTTON_PIN_C3);
     if (lastStateC3 != currentStateC3 && currentStateC3 == LOW)
     {
-        startTestTask();
+        startTestTask(TestTask, "TestTask");
     }
     lastStateC3 = currentStateC3;
 
     int8_t currentStateS2 = digitalRead(BUTTON_PIN_S2);
     if (lastStateS2 != currentStateS2 && currentStateS2 == LOW)
     {
-        startTestTask();
+        startTestTask(TestTask, "TestTask");
     }
     lastStateS2 = currentStateS2;
 #endif
-}
 
-static void WiFiProcessing()
-{
-    int n = WiFi.scanNetworks();
-    if (n == 0)
-    {
-        Serial.println("no networks found");
-    }
-    else
-    {
-        Serial.print(n);
-        Serial.println(" networks found");
-        Serial.println("Nr | SSID                             | RSSI | CH | Encryption");
-        for (int i = 0; i < n; ++i)
-        {
-            Serial.printf("%2d", i + 1);
-            Serial.print(" | ");
-            Serial.printf("%-32.32s", WiFi.SSID(i).c_str());
-            Serial.print(" | ");
-            Serial.printf("%4d", WiFi.RSSI(i));
-            Serial.print(" | ");
-            Serial.printf("%2d", WiFi.channel(i));
-            Serial.print(" | ");
-            switch (WiFi.encryptionType(i))
-            {
-            case WIFI_AUTH_OPEN:
-                Serial.print("open");
-                break;
-            case WIFI_AUTH_WEP:
-                Serial.print("WEP");
-                break;
-            case WIFI_AUTH_WPA_PSK:
-                Serial.print("WPA");
-                break;
-            case WIFI_AUTH_WPA2_PSK:
-                Serial.print("WPA2");
-                break;
-            case WIFI_AUTH_WPA_WPA2_PSK:
-                Serial.print("WPA+WPA2");
-                break;
-            case WIFI_AUTH_WPA2_ENTERPRISE:
-                Serial.print("WPA2-EAP");
-                break;
-            case WIFI_AUTH_WPA3_PSK:
-                Serial.print("WPA3");
-                break;
-            case WIFI_AUTH_WPA2_WPA3_PSK:
-                Serial.print("WPA2+WPA3");
-                break;
-            case WIFI_AUTH_WAPI_PSK:
-                Serial.print("WAPI");
-                break;
-            default:
-                Serial.print("unknown");
-            }
-            Serial.println();
-            delay(10);
-        }
-    }
-
-    Serial.println();
-    WiFi.scanDelete();
+    loopActivity.busyMicros += micros() - woke;
 }
 
-static void TimeTask(void *parameter)
+// The link, NTP and the report sinks share one task. Sinks are sent as
+// soon as they are queued; otherwise it sleeps until the network needs
+// its next step, or SINK_POLL_MS for a sink that is waiting to retry.
+static void NetworkTask(void *parameter)
 {
     for (;;)
     {
-        if (WiFi.status() == WL_CONNECTED && WiFi.getMode() == WIFI_STA)
-        {
-            WiFiUDP ntpUDP;
-            NTPClient timeClient(ntpUDP);
-            timeClient.begin();
-            if (timeClient.update())
-            {
-                timeIsValid = false;
-                rtc.setTime(timeClient.getEpochTime());
-                timeIsValid = true;
-                Serial.print("Time updated: ");
-                Serial.println(rtc.getDateTime(true));
-            }
-            timeClient.end();
-            delay(120000);
-        }
-        else
-        {
-            delay(500);
-        }
+        uint32_t waitMs = serviceNetwork();
+        if (!serviceSinks())
+            waitForSinkWork(waitMs < SINK_POLL_MS ? waitMs : SINK_POLL_MS);
     }
     vTaskDelete(NULL);
 }
 
-static void WiFiTask(void *parameter)
+static void WsjtxTask(void *parameter)
 {
     for (;;)
-    {
-        if (WiFi.status() != WL_CONNECTED)
-        {
-            WiFiManager mgr;
-            bool res = mgr.autoConnect("DX_FT8_Xceiver");
-            if (!res)
-            {
-                mgr.resetSettings();
-                Serial.println("Failed to connect");
-                delay(1000);
-            }
-            else
-            {
-                Serial.println("WiFi connected");
-                Serial.print("IP address: ");
-                Serial.println(WiFi.localIP());
-            }
-        }
-        delay(30000);
-    }
+        watchWsjtxListener();
     vTaskDelete(NULL);
 }
 
-static size_t addSenderRecord(uint8_t *buffer, size_t bufferSizeIn, const char *callsign, const char *gridSquare)
-{
-    size_t result = 0;
-    size_t callsignLength = strlen(callsign);
-    size_t gridSquareLength = strlen(gridSquare);
-
-    size_t bufferSize = sizeof(uint8_t) + callsignLength + sizeof(uint8_t) + gridSquareLength;
-    if (bufferSize < bufferSizeIn)
-    {
-        uint8_t *ptr = buffer;
-        // Add callsign as length-delimited
-        *ptr++ = (uint8_t)callsignLength;
-        memcpy(ptr, callsign, callsignLength);
-        ptr += callsignLength;
-
-        // Add gridSquare as length-delimited
-        *ptr++ = (uint8_t)gridSquareLength;
-        memcpy(ptr, gridSquare, gridSquareLength);
-        ptr += gridSquareLength;
-        result = ptr - buffer;
-    }
-    return result;
-}
-
-static size_t addSenderSoftwareRecord(uint8_t *buffer, size_t bufferSizeIn, const char *software)
-{
-    size_t result = 0;
-    size_t softwareLength = strlen(software);
-
-    size_t bufferSize = sizeof(uint8_t) + softwareLength;
-    if (bufferSize < bufferSizeIn)
-    {
-        uint8_t *ptr = buffer;
-        // Add software as length-delimited
-        *ptr++ = (uint8_t)softwareLength;
-        memcpy(ptr, software, softwareLength);
-        ptr += softwareLength;
-
-        result = ptr - buffer;
-    }
-    return result;
-}
-
-static size_t addReceivedRecord(uint8_t *buffer, size_t bufferSizeIn, const char *callsign, uint32_t frequency, uint8_t snr)
+#ifdef TESTING
+static void TestTask(void *parameter)
 {
-    size_t result = 0;
-    size_t callsignLength = strlen(callsign);
-    size_t bufferSize = sizeof(uint8_t) + callsignLength + sizeof(uint32_t) + sizeof(uint8_t);
-    if (bufferSize < bufferSizeIn)
-    {
-        uint8_t *ptr = buffer;
-        // Add callsign as length-delimited
-        *ptr++ = (uint8_t)callsignLength;
-        memcpy(ptr, callsign, callsignLength);
-        ptr += (uint8_t)callsignLength;
-
-        // Add frequency
-        memcpy(ptr, &frequency, sizeof(frequency));
-        ptr += sizeof(frequency);
+    testTaskRunning = true;
+    Serial.println("TestTask started");
 
-        // Add SNR (1 byte)
-        *ptr++ = snr;
+    LoadGeneratorConfig config;
+    LoadGeneratorReport report;
+    runLoadGenerator(config, report);
+    printLoadGeneratorReport(config, report);
 
-        result = ptr - buffer;
-    }
-    return result;
+    Serial.println("TestTask completed");
+    testTaskRunning = false;
+    vTaskDelete(NULL);
 }
 
-#ifdef TESTING
-static void TestTask(void *parameter)
+// Two weeks of traffic through a reporter of its own, reading the heap as
+// it goes. Reports are not sent while it runs.
+static void SoakTask(void *parameter)
 {
     testTaskRunning = true;
+    Serial.println("SoakTask started");
+
+    SoakConfig config;
+    SoakReport report;
+    runSoakTest(config, report);
+    printSoakReport(config, report);
 
-    PskReporter &pskReporter = getPskReporter();
-    int sequenceNumber = 0;
-    Serial.println("TestTask started");
-    uint8_t encodedBuff[32];
-    memset(encodedBuff, 0, sizeof(encodedBuff));
-    addSenderRecord(encodedBuff, sizeof(encodedBuff), "G8KIG", "IO91iq");
-    pskReporter.createSenderRecord(encodedBuff);
-
-    memset(encodedBuff, 0, sizeof(encodedBuff));
-    addSenderSoftwareRecord(encodedBuff, sizeof(encodedBuff), "DX FT8 Transceiver (Test)");
-    pskReporter.createSenderSoftwareRecord(encodedBuff);
-    Serial.println("TestTask add received records");
-    for (int idx = 0; idx < 10; ++idx)
-    {
-        char callsign[16];
-        sprintf(callsign, "G8KIG-%u", idx);
-        memset(encodedBuff, 0, sizeof(encodedBuff));
-        addReceivedRecord(encodedBuff, sizeof(encodedBuff), callsign, (uint32_t)(14031 + idx), (uint8_t)(127 + (-idx)));
-        pskReporter.addReceivedRecord(encodedBuff);
-        delay(1000);
-    }
-    pskReporter.send();
-    Serial.println("TestTask completed");
     testTaskRunning = false;
     vTaskDelete(NULL);
 }
@@ -8,87 +8,357 @@
 #include <Arduino.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
-#include <freertos/queue.h>
 #include <freertos/semphr.h>
 
 #include "main.h"
+#include "LatencyHistogram.h"
 #include "workqueue.h"
+#include "FrameDecoder.h"
+#include "RecordStore.h"
+#include "IngressFilter.h"
 
-#define MAX_WORK_ITEMS 20
+#define MAX_BULK_ITEMS 20
+static_assert(INGRESS_FILTER_DEPTH <= MAX_BULK_ITEMS, "repeats would never be dropped");
 
-static WorkItem workItems[MAX_WORK_ITEMS];
+struct ControlOperation
+{
+    I2COperation operation;
+    bool perReceiver; // a slot for each receiver, or one shared by all
+};
+
+// Control operations in the order they are served. A send request flushes
+// every receiver, so one is enough.
+static const ControlOperation controlOperations[] = {
+    {OP_TIME_REQUEST, false},
+    {OP_SENDER_RECORD, true},
+    {OP_SENDER_SOFTWARE_RECORD, true},
+    {OP_SEND_REQUEST, false}};
+static const int CONTROL_OPERATIONS = sizeof(controlOperations) / sizeof(controlOperations[0]);
+static const int CONTROL_SLOTS = CONTROL_OPERATIONS * MAX_RECEIVERS;
+
+static WorkItem controlItems[CONTROL_SLOTS];
+static bool controlPending[CONTROL_SLOTS];
+
+static WorkItem bulkItems[MAX_BULK_ITEMS];
+static int bulkHead = 0;
+static int bulkCount = 0;
+
+static uint32_t nextSequence = 0;
 static SemaphoreHandle_t workMutex;
-static QueueHandle_t workQueue;
+static WorkQueueSignal workSignal = NULL;
+static IngressFilter *ingressFilter = NULL;
+static WorkQueueStats workStats;
+#if WORKQUEUE_LOGGING
+static bool loggingEnabled = true;
+#else
+static const bool loggingEnabled = false;
+#endif
+
+static const char *const laneNames[LANE_COUNT] = {"control", "bulk"};
 
-static int allocateWorkItem()
+// Slots are grouped by operation, then by receiver
+static int controlSlot(I2COperation operation, uint8_t receiver)
 {
-    int index = -1;
-    xSemaphoreTake(workMutex, portMAX_DELAY);
-    for (int i = 0; i < MAX_WORK_ITEMS; i++)
+    for (int idx = 0; idx < CONTROL_OPERATIONS; ++idx)
     {
-        if (workItems[i].state == ITEM_FREE)
-        {
-            workItems[i].state = ITEM_ALLOCATED;
-            index = i;
-            break;
-        }
+        if (controlOperations[idx].operation == operation)
+            return idx * MAX_RECEIVERS + (controlOperations[idx].perReceiver ? receiver : 0);
     }
-    xSemaphoreGive(workMutex);
-    return index;
+    return -1;
+}
+
+static int usableControlSlots()
+{
+    int slots = 0;
+    for (int idx = 0; idx < CONTROL_OPERATIONS; ++idx)
+        slots += controlOperations[idx].perReceiver ? MAX_RECEIVERS : 1;
+    return slots;
 }
 
-void addWorkQueueItem(I2COperation operation, const uint8_t *buffer, int bufferSize)
+static void fillWorkItem(WorkItem *workItem, I2COperation operation, const uint8_t *buffer, int bufferSize, uint8_t receiver)
 {
-    int index = allocateWorkItem();
-    if (index >= 0)
+    workItem->operation = operation;
+    workItem->receiver = receiver;
+    workItem->sequence = nextSequence++;
+    workItem->queuedMicros = micros();
+    workItem->length = 0;
+    if (buffer != NULL && bufferSize > 0)
     {
-        Serial.printf("addWorkQueueItem(): queued %d with op. %d\n", index, operation);
-        WorkItem *workItem = workItems + index;
-        workItem->operation = operation;
-        if (buffer != NULL && bufferSize > 0)
-        {
-            memcpy(workItem->buffer, buffer, bufferSize);
-            memset(workItem->buffer + bufferSize, 0, sizeof(workItem->buffer) - bufferSize);
-        }
-        xQueueSend(workQueue, &index, portMAX_DELAY);
+        if (bufferSize > (int)sizeof(workItem->buffer))
+            bufferSize = sizeof(workItem->buffer);
+        memcpy(workItem->buffer, buffer, bufferSize);
+        workItem->length = (uint8_t)bufferSize;
     }
+    memset(workItem->buffer + workItem->length, 0, sizeof(workItem->buffer) - workItem->length);
+}
+
+bool addWorkQueueItem(I2COperation operation, const uint8_t *buffer, int bufferSize, uint8_t receiver)
+{
+    if (receiver >= MAX_RECEIVERS)
+        return false;
+
+    bool result = true;
+    bool coalesced = false;
+    int slot = controlSlot(operation, receiver);
+    WorkQueueLane lane = slot >= 0 ? LANE_CONTROL : LANE_BULK;
+    WorkLaneStats &stats = workStats.lanes[lane];
+
+    xSemaphoreTake(workMutex, portMAX_DELAY);
+    if (lane == LANE_CONTROL)
+    {
+        // a newer request replaces the one still waiting, but keeps the
+        // original queued time so the latency is not under-reported
+        coalesced = controlPending[slot];
+        uint32_t queuedMicros = controlItems[slot].queuedMicros;
+        fillWorkItem(controlItems + slot, operation, buffer, bufferSize, receiver);
+        if (coalesced)
+            controlItems[slot].queuedMicros = queuedMicros;
+        controlPending[slot] = true;
+    }
+    else if (bulkCount < MAX_BULK_ITEMS)
+    {
+        fillWorkItem(bulkItems + (bulkHead + bulkCount) % MAX_BULK_ITEMS, operation, buffer, bufferSize, receiver);
+        bulkCount++;
+    }
+    else
+    {
+        result = false;
+    }
+
+    if (!result)
+    {
+        stats.dropped++;
+    }
+    else if (coalesced)
+    {
+        stats.coalesced++;
+    }
+    else
+    {
+        stats.queued++;
+        if (++stats.depth > stats.highWater)
+            stats.highWater = stats.depth;
+    }
+    xSemaphoreGive(workMutex);
+    if (result && workSignal != NULL)
+        workSignal();
+
+    if (loggingEnabled)
+    {
+        if (!result)
+            Serial.printf("addWorkQueueItem(): %s lane full, dropped op. %d\n", laneNames[lane], operation);
+        else
+            Serial.printf("addWorkQueueItem(): %s op. %d on %s lane\n", coalesced ? "coalesced" : "queued", operation, laneNames[lane]);
+    }
+    return result;
 }
 
 void initialiseWorkQueue()
 {
-    workQueue = xQueueCreate(MAX_WORK_ITEMS, sizeof(int));
+#ifdef STATIC_ALLOCATION
+    static StaticSemaphore_t workMutexBuffer;
+    workMutex = xSemaphoreCreateMutexStatic(&workMutexBuffer);
+#else
     workMutex = xSemaphoreCreateMutex();
-    memset(workItems, 0, sizeof(workItems));
+#endif
+    memset(controlItems, 0, sizeof(controlItems));
+    memset(controlPending, 0, sizeof(controlPending));
+    memset(bulkItems, 0, sizeof(bulkItems));
+    resetWorkQueueStats();
 }
 
-void processWorkQueue()
+void setWorkQueueSignal(WorkQueueSignal signal)
 {
-    int index = 0;
-    if (xQueueReceive(workQueue, &index, 0) == pdPASS)
+    workSignal = signal;
+}
+
+void setIngressFilter(IngressFilter *filter)
+{
+    ingressFilter = filter;
+}
+
+size_t getWorkQueueFootprint()
+{
+    return sizeof(controlItems) + sizeof(controlPending) + sizeof(bulkItems) + sizeof(workStats);
+}
+
+void getWorkQueueStats(WorkQueueStats &stats)
+{
+    xSemaphoreTake(workMutex, portMAX_DELAY);
+    stats = workStats;
+    xSemaphoreGive(workMutex);
+}
+
+void printWorkQueueStats()
+{
+    WorkQueueStats stats;
+    getWorkQueueStats(stats);
+    for (int lane = 0; lane < LANE_COUNT; ++lane)
+    {
+        const WorkLaneStats &laneStats = stats.lanes[lane];
+        Serial.printf("%-7s lane: depth %d/%d (high %d), queued %u, coalesced %u, processed %u, dropped %u, p99 %u us\n",
+                      laneNames[lane], laneStats.depth, laneStats.capacity, laneStats.highWater,
+                      laneStats.queued, laneStats.coalesced, laneStats.processed, laneStats.dropped,
+                      laneStats.latency.percentile(99));
+    }
+    if (ingressFilter != NULL)
+        ingressFilter->printStats();
+}
+
+void resetWorkQueueStats()
+{
+    xSemaphoreTake(workMutex, portMAX_DELAY);
+    for (int lane = 0; lane < LANE_COUNT; ++lane)
+    {
+        WorkLaneStats &stats = workStats.lanes[lane];
+        stats.queued = 0;
+        stats.coalesced = 0;
+        stats.processed = 0;
+        stats.dropped = 0;
+        stats.highWater = stats.depth;
+        stats.capacity = lane == LANE_CONTROL ? usableControlSlots() : MAX_BULK_ITEMS;
+        stats.latency.reset();
+    }
+    xSemaphoreGive(workMutex);
+    if (ingressFilter != NULL)
+        ingressFilter->resetStats();
+}
+
+void setWorkQueueLogging(bool enabled)
+{
+#if WORKQUEUE_LOGGING
+    loggingEnabled = enabled;
+#endif
+}
+
+// Picks the next item to run, called with the mutex held.
+// A send request waits for any spots that arrived before it so they are
+// included in the datagram it triggers.
+static bool takeNextWorkItem(WorkItem &workItem, WorkQueueLane &lane)
+{
+    for (int slot = 0; slot < CONTROL_SLOTS; ++slot)
+    {
+        if (!controlPending[slot])
+            continue;
+
+        if (controlItems[slot].operation == OP_SEND_REQUEST &&
+            bulkCount > 0 &&
+            (int32_t)(bulkItems[bulkHead].sequence - controlItems[slot].sequence) < 0)
+            continue;
+
+        workItem = controlItems[slot];
+        controlPending[slot] = false;
+        lane = LANE_CONTROL;
+        return true;
+    }
+
+    if (bulkCount > 0)
+    {
+        workItem = bulkItems[bulkHead];
+        bulkHead = (bulkHead + 1) % MAX_BULK_ITEMS;
+        bulkCount--;
+        lane = LANE_BULK;
+        return true;
+    }
+    return false;
+}
+
+bool processWorkQueue()
+{
+    WorkItem workItem;
+    WorkQueueLane lane;
+
+    // The item is copied out so the slot is free again while it is processed
+    xSemaphoreTake(workMutex, portMAX_DELAY);
+    bool found = takeNextWorkItem(workItem, lane);
+    if (found)
+        workStats.lanes[lane].depth--;
+    xSemaphoreGive(workMutex);
+    if (!found)
+        return false;
+
+    I2COperation operation = workItem.operation;
+    switch (operation)
     {
-        xSemaphoreTake(workMutex, portMAX_DELAY);
-        WorkItem *workItem = workItems + index;
-        I2COperation operation = workItem->operation;
-        switch (operation)
-        {
-        case OP_TIME_REQUEST:
-            processTimeRequest((const RTCTime *)workItem->buffer);
-            break;
-        case OP_SENDER_RECORD:
-            processSenderRecord(workItem->buffer);
-            break;
-        case OP_SENDER_SOFTWARE_RECORD:
-            processSenderSoftwareRecord(workItem->buffer);
-            break;
-        case OP_RECEIVER_RECORD:
-            processReceiverRecord(workItem->buffer);
-            break;
-        case OP_SEND_REQUEST:
-            processSendRequest();
-            break;
-        }
-        workItem->state = ITEM_FREE;
-        xSemaphoreGive(workMutex);
-        Serial.printf("processWorkQueue(): processed %d with op. %d\n", index, operation);
+    case OP_TIME_REQUEST:
+        processTimeRequest((const RTCTime *)workItem.buffer);
+        break;
+    case OP_SENDER_RECORD:
+        processSenderRecord(workItem.receiver, workItem.buffer, workItem.length);
+        break;
+    case OP_SENDER_SOFTWARE_RECORD:
+        processSenderSoftwareRecord(workItem.receiver, workItem.buffer, workItem.length);
+        break;
+    case OP_RECEIVER_RECORD:
+        processReceiverRecord(workItem.receiver, workItem.buffer, workItem.length);
+        break;
+    case OP_PACKED_RECEIVER_RECORD:
+        processPackedReceiverRecord(workItem.receiver, workItem.buffer, workItem.length);
+        break;
+    case OP_SEND_REQUEST:
+        processSendRequest();
+        break;
+    }
+
+    xSemaphoreTake(workMutex, portMAX_DELAY);
+    WorkLaneStats &stats = workStats.lanes[lane];
+    stats.processed++;
+    stats.latency.record(micros() - workItem.queuedMicros);
+    xSemaphoreGive(workMutex);
+    if (loggingEnabled)
+        Serial.printf("processWorkQueue(): processed op. %d from %s lane\n", operation, laneNames[lane]);
+    return true;
+}
+
+// A repeat only refreshes a record that is already waiting, so once the
+// bulk lane is backing up it is dropped here rather than take a slot a new
+// station could have. The depth is read without the lock: being a spot out
+// either way only moves the point at which dropping starts.
+static bool isKnownRepeat(I2COperation operation, const uint8_t *payload, size_t length, uint8_t receiver)
+{
+    if (ingressFilter == NULL)
+        return false;
+
+    ReceivedRecordView record;
+    bool decoded = operation == OP_PACKED_RECEIVER_RECORD ? decodePackedReceivedRecord(payload, length, record)
+                                                          : decodeReceivedRecord(payload, length, record);
+    if (!decoded)
+        return false;
+    return ingressFilter->checkArrival(receiver, RecordStore::stationKey(record),
+                                       bulkCount >= INGRESS_FILTER_DEPTH);
+}
+
+// Entry point for every opcode frame however it arrived: the first byte is
+// the receiver and operation, the rest is its payload
+void handleReceivedFrame(const uint8_t *frame, size_t length)
+{
+    if (frame == NULL || length == 0)
+        return;
+
+    const uint8_t *payload = frame + 1;
+    size_t payloadLength = length - 1;
+    I2COperation operation = frameOperation(frame[0]);
+    uint8_t receiver = frameReceiver(frame[0]);
+    switch (operation)
+    {
+    case OP_TIME_REQUEST:
+        // Nothing to do - the transport sends the time back itself
+        break;
+
+    case OP_SENDER_RECORD:
+    case OP_SENDER_SOFTWARE_RECORD:
+        if (payloadLength > 0)
+            addWorkQueueItem(operation, payload, payloadLength, receiver);
+        break;
+
+    case OP_RECEIVER_RECORD:
+    case OP_PACKED_RECEIVER_RECORD:
+        if (payloadLength > 0 && !isKnownRepeat(operation, payload, payloadLength, receiver))
+            addWorkQueueItem(operation, payload, payloadLength, receiver);
+        break;
+
+    case OP_SEND_REQUEST:
+        addWorkQueueItem(OP_SEND_REQUEST, NULL, 0);
+        break;
     }
 }